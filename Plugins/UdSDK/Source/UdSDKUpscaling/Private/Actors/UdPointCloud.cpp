@@ -11,7 +11,8 @@
 AUdPointCloud::AUdPointCloud()
 {
 	//UDSDK_INFO_MSG("AUdPointCloud::AUdPointCloud : %d", GetUniqueID());
-	PrimaryActorTick.bCanEverTick = true;
+	// CUdPointCloudTracker follows the editor state, nothing is left to do per frame
+	PrimaryActorTick.bCanEverTick = false;
 	bWasDuplicatedForPIE = false;
 	bWasHiddenEd = false;
 	bWasSelectedInEditor = false;
@@ -64,31 +65,16 @@ void AUdPointCloud::OnConstruction(const FTransform& Transform)
 	//UDSDK_SCREENDE_DEBUG_MSG("AUdPointCloud::OnConstruction : %d", GetUniqueID());
 }
 
-bool AUdPointCloud::ShouldTickIfViewportsOnly() const
-{
-	//UDSDK_INFO_MSG("AUdPointCloud::ShouldTickIfViewportsOnly : %d", GetUniqueID());
-	return UpdateInEditor;
-}
-
-void AUdPointCloud::Tick(float DeltaTime)
+#if WITH_EDITOR
+void AUdPointCloud::SyncEditorState()
 {
-	Super::Tick(DeltaTime);
-
-	//if (SuspendUpdate) {
-	//	return;
-	//}
+	if (!UpdateInEditor)
+		return;
 
-#if WITH_EDITOR
 	if (bWasHiddenEd != IsHiddenEd())
 	{
-		if (IsHiddenEd())
-		{
-			DestroyPointCloud();
-		}
-		else
-		{
-			LoadPointCloud();
-		}
+		// the point cloud stays loaded while hidden, it is only left out of the render
+		ShowPointCloud(!IsHiddenEd());
 		bWasHiddenEd = IsHiddenEd();
 	}
 
@@ -98,14 +84,8 @@ void AUdPointCloud::Tick(float DeltaTime)
 
 		bWasSelectedInEditor = IsSelectedInEditor();
 	}
-#endif //WITH_EDITOR
-
-	//if (!pAsset.Get())
-	//{
-	//	LoadPointCloud();
-	//}
-
 }
+#endif //WITH_EDITOR
 
 void AUdPointCloud::BeginDestroy()
 {
@@ -173,6 +153,13 @@ void AUdPointCloud::PostEditChangeProperty(FPropertyChangedEvent& PropertyChange
 		//UDSDK_INFO_MSG("AUdPointCloud::PostEditChangeProperty Url : %d", GetUniqueID());
 		ReloadPointCloud();
 	}
+	else if (
+		PropName == GET_MEMBER_NAME_CHECKED(AUdPointCloud, MaxDrawDistance)
+		&& pAsset.Get()
+		)
+	{
+		CUdSDKComposite::Get()->AsyncSetMaxDrawDistance(GetUniqueID(), MaxDrawDistance);
+	}
 }
 
 void AUdPointCloud::PostEditUndo()
@@ -218,11 +205,13 @@ void AUdPointCloud::LoadPointCloud()
 	pAsset->url = GetUrl();
 	pAsset->coords = Transform.GetLocation();
 	pAsset->geometry = true;
+	pAsset->max_draw_distance = MaxDrawDistance;
 	CUdSDKComposite::Get()->AsyncLoad(GetUniqueID(), pAsset, [this]{
 		const FTransform& Transform = RootComponent->GetRelativeTransform();
 		CUdSDKComposite::Get()->AsyncSetTransform(GetUniqueID(), Transform);
 #if WITH_EDITOR
 		CUdSDKComposite::Get()->AsyncSetSelected(GetUniqueID(), IsSelectedInEditor());
+		CUdSDKComposite::Get()->AsyncSetVisible(GetUniqueID(), !IsHiddenEd());
 #endif //WITH_EDITOR
 	});
 }
@@ -234,24 +223,20 @@ void AUdPointCloud::ReloadPointCloud()
 	if (!CUdSDKComposite::Get()->IsLogin())
 		return;
 
-
-	CUdSDKComposite::Get()->AsyncRemove(GetUniqueID(), [this] {
-		if (Url.IsEmpty())
-			return;
-		const FTransform& Transform = RootComponent->GetRelativeTransform();
-		pAsset = nullptr;
-		pAsset = MakeShared<FUdAsset>(FUdAsset());
-		pAsset->url = GetUrl();
-		pAsset->coords = Transform.GetLocation();
-		pAsset->geometry = true;
-		CUdSDKComposite::Get()->AsyncLoad(GetUniqueID(), pAsset, [this] {
-			const FTransform& Transform = RootComponent->GetRelativeTransform();
-			CUdSDKComposite::Get()->AsyncSetTransform(GetUniqueID(), Transform);
-#if WITH_EDITOR
-			CUdSDKComposite::Get()->AsyncSetSelected(GetUniqueID(), IsSelectedInEditor());
-#endif //WITH_EDITOR
-		});
-	});
+	pAsset = nullptr;
+#if UDSDK_WITH_COROUTINES
+	// the load starts once the remove is done, back on the game thread. A reload issued meanwhile
+	// has already queued its own remove ahead of it, and LoadPointCloud skips an actor that has an asset again
+	[](TWeakObjectPtr<AUdPointCloud> InActor, uint32 InUniqueID) -> CFireAndForget {
+		co_await CUdSDKComposite::Get()->RemoveAsync(InUniqueID);
+		if (AUdPointCloud* Actor = InActor.Get())
+			Actor->LoadPointCloud();
+	}(this, GetUniqueID());
+#else
+	// the remove and the load run in this order on the actor's serial queue
+	CUdSDKComposite::Get()->AsyncRemove(GetUniqueID());
+	LoadPointCloud();
+#endif
 }
 
 void AUdPointCloud::DestroyPointCloud()
@@ -278,6 +263,16 @@ void AUdPointCloud::SelectPointCloud(bool InSelect)
 	CUdSDKComposite::Get()->AsyncSetSelected(GetUniqueID(), InSelect);
 }
 
+void AUdPointCloud::ShowPointCloud(bool InVisible)
+{
+	if (bWasDuplicatedForPIE)
+		return;
+	if (!pAsset.Get())
+		return;
+
+	CUdSDKComposite::Get()->AsyncSetVisible(GetUniqueID(), InVisible);
+}
+
 void AUdPointCloud::LoginPointCloud()
 {
 	//UDSDK_INFO_MSG("AUdPointCloud::LoginPointCloud : %d", GetUniqueID());
@@ -1,5 +1,6 @@
 #include "UdPointCloudRoot.h"
 #include "Actors/UdPointCloud.h"
+#include "Actors/UdPointCloudTracker.h"
 #include "Engine/World.h"
 #include "UdSDKMacro.h"
 
@@ -30,6 +31,39 @@ void UUdPointCloudRoot::BeginPlay()
   //UDSDK_INFO_MSG("UUdPointCloudRoot::BeginPlay : %d", GetUniqueID());
 }
 
+#if WITH_EDITOR
+void UUdPointCloudRoot::OnRegister()
+{
+  Super::OnRegister();
+  AUdPointCloud* pPointCloud = GetOwner<AUdPointCloud>();
+  if (pPointCloud && CUdPointCloudTracker::Get())
+  {
+    CUdPointCloudTracker::Get()->Register(pPointCloud);
+  }
+}
+
+void UUdPointCloudRoot::OnUnregister()
+{
+  AUdPointCloud* pPointCloud = GetOwner<AUdPointCloud>();
+  if (pPointCloud && CUdPointCloudTracker::Get())
+  {
+    CUdPointCloudTracker::Get()->Unregister(pPointCloud);
+  }
+  Super::OnUnregister();
+}
+
+void UUdPointCloudRoot::CreateRenderState_Concurrent(
+    FRegisterComponentContext* Context)
+{
+  Super::CreateRenderState_Concurrent(Context);
+  AUdPointCloud* pPointCloud = GetOwner<AUdPointCloud>();
+  if (pPointCloud && CUdPointCloudTracker::Get())
+  {
+    CUdPointCloudTracker::Get()->MarkDirty(pPointCloud);
+  }
+}
+#endif // WITH_EDITOR
+
 bool UUdPointCloudRoot::MoveComponentImpl(
     const FVector& Delta,
     const FQuat& NewRotation,
@@ -16,6 +16,14 @@ public:
 
 protected:
   virtual void BeginPlay() override;
+#if WITH_EDITOR
+  virtual void OnRegister() override;
+  virtual void OnUnregister() override;
+  // Recreated when the owner is hidden or shown in the editor, which is how
+  // CUdPointCloudTracker hears about it
+  virtual bool ShouldCreateRenderState() const override { return true; }
+  virtual void CreateRenderState_Concurrent(FRegisterComponentContext* Context) override;
+#endif // WITH_EDITOR
   virtual bool MoveComponentImpl(
       const FVector& Delta,
       const FQuat& NewRotation,
@@ -0,0 +1,134 @@
+#include "UdPointCloudTracker.h"
+#include "Actors/UdPointCloud.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "UdSDKStats.h"
+#if WITH_EDITOR
+#include "Engine/Selection.h"
+#endif //WITH_EDITOR
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Tracked Point Clouds"), STAT_UdsTrackedPointClouds, STATGROUP_UdSDK);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Editor State Syncs"), STAT_UdsEditorStateSyncs, STATGROUP_UdSDK);
+DECLARE_CYCLE_STAT(TEXT("Editor State Flush"), STAT_UdsEditorStateFlush, STATGROUP_UdSDK);
+// Tracked actors that used to tick every editor frame just to poll their state, the flush above is what replaced them
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Actor Ticks Avoided Per Frame"), STAT_UdsActorTicksAvoided, STATGROUP_UdSDK);
+
+CUdPointCloudTracker::CUdPointCloudTracker()
+{
+#if WITH_EDITOR
+	TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &CUdPointCloudTracker::Flush));
+	SelectionChangedHandle = USelection::SelectionChangedEvent.AddRaw(this, &CUdPointCloudTracker::OnSelectionChanged);
+	SelectObjectHandle = USelection::SelectObjectEvent.AddRaw(this, &CUdPointCloudTracker::OnSelectionChanged);
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddRaw(this, &CUdPointCloudTracker::OnLevelChanged);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddRaw(this, &CUdPointCloudTracker::OnLevelChanged);
+#endif //WITH_EDITOR
+}
+
+CUdPointCloudTracker::~CUdPointCloudTracker()
+{
+#if WITH_EDITOR
+	FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+	USelection::SelectionChangedEvent.Remove(SelectionChangedHandle);
+	USelection::SelectObjectEvent.Remove(SelectObjectHandle);
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+#endif //WITH_EDITOR
+}
+
+void CUdPointCloudTracker::Register(AUdPointCloud* InPointCloud)
+{
+	bool bAlreadyTracked = false;
+	PointClouds.Add(InPointCloud, &bAlreadyTracked);
+	if (!bAlreadyTracked)
+	{
+		INC_DWORD_STAT(STAT_UdsActorTicksAvoided);
+	}
+	// it may come in hidden or selected already
+	MarkDirty(InPointCloud);
+}
+
+void CUdPointCloudTracker::Unregister(AUdPointCloud* InPointCloud)
+{
+	if (PointClouds.Remove(InPointCloud) > 0)
+	{
+		DEC_DWORD_STAT(STAT_UdsActorTicksAvoided);
+	}
+	Selected.Remove(InPointCloud);
+
+	FScopeLock ScopeLock(&DirtyMutex);
+	Dirty.Remove(InPointCloud);
+}
+
+void CUdPointCloudTracker::MarkDirty(AUdPointCloud* InPointCloud)
+{
+	FScopeLock ScopeLock(&DirtyMutex);
+	Dirty.Add(InPointCloud);
+}
+
+bool CUdPointCloudTracker::Flush(float InDeltaTime)
+{
+	SET_DWORD_STAT(STAT_UdsTrackedPointClouds, PointClouds.Num());
+
+	TSet<AUdPointCloud*> Batch;
+	{
+		FScopeLock ScopeLock(&DirtyMutex);
+		if (Dirty.Num() == 0)
+			return true;
+		Batch = MoveTemp(Dirty);
+		Dirty.Reset();
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_UdsEditorStateFlush);
+#if WITH_EDITOR
+	for (AUdPointCloud* PointCloud : Batch)
+	{
+		// unregistered since it was marked
+		if (!PointClouds.Contains(PointCloud))
+			continue;
+
+		PointCloud->SyncEditorState();
+		if (PointCloud->IsSelectedInEditor())
+			Selected.Add(PointCloud);
+		else
+			Selected.Remove(PointCloud);
+	}
+	INC_DWORD_STAT_BY(STAT_UdsEditorStateSyncs, Batch.Num());
+#endif //WITH_EDITOR
+	return true;
+}
+
+void CUdPointCloudTracker::OnSelectionChanged(UObject* InObject)
+{
+#if WITH_EDITOR
+	if (AUdPointCloud* PointCloud = Cast<AUdPointCloud>(InObject))
+	{
+		MarkDirty(PointCloud);
+		return;
+	}
+
+	USelection* Selection = Cast<USelection>(InObject);
+	if (!Selection)
+		return;
+
+	// a whole new selection: what was selected may not be any more, what is selected now is looked at too
+	FScopeLock ScopeLock(&DirtyMutex);
+	Dirty.Append(Selected);
+	for (FSelectionIterator It(*Selection); It; ++It)
+	{
+		if (AUdPointCloud* PointCloud = Cast<AUdPointCloud>(*It))
+		{
+			Dirty.Add(PointCloud);
+		}
+	}
+#endif //WITH_EDITOR
+}
+
+void CUdPointCloudTracker::OnLevelChanged(ULevel* InLevel, UWorld* InWorld)
+{
+	FScopeLock ScopeLock(&DirtyMutex);
+	for (AUdPointCloud* PointCloud : PointClouds)
+	{
+		if (PointCloud->GetLevel() == InLevel)
+			Dirty.Add(PointCloud);
+	}
+}
@@ -2,11 +2,12 @@
 
 #include "UdsSubpassSharedTypes.h"
 #include "PostProcess/PostProcessTonemap.h"
+#include "UdSDKViewState.h"
 
 struct FUdsData
 {
 	bool bInitialized = false;
-	bool bEnabled;
+	bool bEnabled = false;
 
 	//FRDGTextureDesc FSROutputTextureDesc;
 	//FPostProcessSettings ChromaticAberrationPostProcessSettings;
@@ -19,5 +20,11 @@ struct FUdsData
 	FRDGTextureRef SceneDepthTexture;
 	FTexture2DRHIRef UdColorTexture;
 	FTexture2DRHIRef UdDepthTexture;
+	//Keeps the view's temporal history and the info of the frame the textures hold
+	FUdViewStatePtr ViewState;
+
+	//What the composite samples: the UDS textures themselves, or their upscaled copies
+	FRDGTextureRef UdColorInput;
+	FRDGTextureRef UdDepthInput;
 	FScreenPassTexture FinalOutput;
 };
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "UdsSubpassComposite.h"
 #include "UdSDKComposite.h"
 #include "Engine/TextureRenderTarget2D.h"
+#include "RenderGraphUtils.h"
+#include "UdSDKStats.h"
+#include "UdSDKDepthKernels.h"
 
 static int32 GUdsComposite = 1;
 static FAutoConsoleVariableRef CVarUdsComposite(
@@ -9,6 +12,17 @@ static FAutoConsoleVariableRef CVarUdsComposite(
 	TEXT("Uds Composite Enabled = 1 or 0"),
 	ECVF_RenderThreadSafe);
 
+static int32 GUdsCompositeCompute = 1;
+static FAutoConsoleVariableRef CVarUdsCompositeCompute(
+	TEXT("r.Uds.Composite.Compute"),
+	GUdsCompositeCompute,
+	TEXT("Composite in 8x8 compute tiles that only forward the scene color where the UDS image is clear = 1 or 0.\n")
+	TEXT("Falls back to the pixel shader when the output can't be written as a UAV"),
+	ECVF_RenderThreadSafe);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Composite Tiles"), STAT_UdsCompositeTiles, STATGROUP_UdSDK);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Composite Tiles Skipped"), STAT_UdsCompositeTilesSkipped, STATGROUP_UdSDK);
+
 
 
 ///
@@ -36,9 +50,165 @@ public:
 
 IMPLEMENT_GLOBAL_SHADER(FUdsCompositePS, "/Plugins/UdSDK/Private/Uds_Composite.usf", "MainPS", SF_Pixel);
 
+///
+/// COMPUTE SHADER
+///
+class FUdsCompositeCS : public FGlobalShader
+{
+public:
+	static const int32 TileSize = 8;
+
+	DECLARE_GLOBAL_SHADER(FUdsCompositeCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsCompositeCS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FCompositePassParameters, Composite)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, RWOutputTexture)
+		SHADER_PARAMETER(FIntPoint, OutputViewMin)
+		SHADER_PARAMETER(FIntPoint, OutputViewMax)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUdsCompositeCS, "/Plugins/UdSDK/Private/Uds_Composite.usf", "MainCS", SF_Compute);
+
+class FUdsCompositeTileListCS : public FGlobalShader
+{
+public:
+	static const int32 MaxGroupsX = 65535;
+
+	DECLARE_GLOBAL_SHADER(FUdsCompositeTileListCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsCompositeTileListCS, FGlobalShader);
+
+	class FCopyOnlyDim : SHADER_PERMUTATION_BOOL("COPY_ONLY");
+	using FPermutationDomain = TShaderPermutationDomain<FCopyOnlyDim>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FCompositePassParameters, Composite)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, RWOutputTexture)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint>, TileList)
+		SHADER_PARAMETER(FIntPoint, OutputViewMin)
+		SHADER_PARAMETER(FIntPoint, OutputViewMax)
+		SHADER_PARAMETER(uint32, TileListOffset)
+		SHADER_PARAMETER(uint32, TileCount)
+		SHADER_PARAMETER(uint32, TileGroupsX)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUdsCompositeTileListCS, "/Plugins/UdSDK/Private/Uds_Composite.usf", "TileListCS", SF_Compute);
+
+// Sorts the 8x8 output tiles into the ones a UDS pixel can reach and the rest, using the
+// CPU coverage mask of the presented UDS image. OutTiles holds the covered tiles first.
+// Returns the number of covered tiles, INDEX_NONE when there is no usable mask
+static int32 BuildCompositeTileList(const FUdViewState& InViewState, const FIntPoint& InUdSize, const FIntPoint& InOutputSize, TArray<uint32>& OutTiles)
+{
+	const TArray<uint8>& Mask = InViewState.TileMask_RenderThread;
+	const FIntPoint MaskSize = InViewState.TileMaskSize_RenderThread;
+	if (Mask.Num() == 0 || MaskSize != FIntPoint::DivideAndRoundUp(InUdSize, UdDepthMaskTileSize) || InOutputSize.X <= 0 || InOutputSize.Y <= 0)
+		return INDEX_NONE;
+
+	const FIntPoint TileCount = FIntPoint::DivideAndRoundUp(InOutputSize, FUdsCompositeCS::TileSize);
+	const FVector2D Scale(InUdSize.X / (float)InOutputSize.X, InUdSize.Y / (float)InOutputSize.Y);
+
+	// mask cells an output tile can read through the bilinear upscale, one texel of margin on each side
+	auto MaskRange = [](int32 InTile, float InScale, int32 InMaskSize) {
+		const int32 First = FMath::FloorToInt(InTile * FUdsCompositeCS::TileSize * InScale - 0.5f);
+		const int32 Last = FMath::FloorToInt((InTile + 1) * FUdsCompositeCS::TileSize * InScale - 0.5f) + 1;
+		return FIntPoint(FMath::Clamp(First / UdDepthMaskTileSize, 0, InMaskSize - 1), FMath::Clamp(Last / UdDepthMaskTileSize, 0, InMaskSize - 1));
+	};
+	TArray<FIntPoint> Columns;
+	Columns.SetNumUninitialized(TileCount.X);
+	for (int32 TileX = 0; TileX < TileCount.X; TileX++)
+	{
+		Columns[TileX] = MaskRange(TileX, Scale.X, MaskSize.X);
+	}
+
+	TArray<uint32> EmptyTiles;
+	OutTiles.Reset(TileCount.X * TileCount.Y);
+	for (int32 TileY = 0; TileY < TileCount.Y; TileY++)
+	{
+		const FIntPoint Rows = MaskRange(TileY, Scale.Y, MaskSize.Y);
+		for (int32 TileX = 0; TileX < TileCount.X; TileX++)
+		{
+			bool bCovered = false;
+			for (int32 y = Rows.X; y <= Rows.Y && !bCovered; y++)
+			{
+				for (int32 x = Columns[TileX].X; x <= Columns[TileX].Y && !bCovered; x++)
+				{
+					bCovered = Mask[y * MaskSize.X + x] != 0;
+				}
+			}
+			(bCovered ? OutTiles : EmptyTiles).Add((uint32)TileX | ((uint32)TileY << 16));
+		}
+	}
+
+	const int32 CoveredCount = OutTiles.Num();
+	OutTiles.Append(EmptyTiles);
+	return CoveredCount;
+}
+
+static void SetCompositeParameters(FCompositePassParameters& OutParameters, const FViewInfo& View, const FUdsData& InData)
+{
+	const FUdFrameInfo& Frame = InData.ViewState->PresentedFrame_RenderThread;
+
+	OutParameters.View = View.ViewUniformBuffer;
+	OutParameters.InputTexture = InData.CurrentInputTexture;
+	OutParameters.DepthTexture = InData.SceneDepthTexture;
+	OutParameters.UdColorTexture = InData.UdColorInput;
+	OutParameters.UdDepthTexture = InData.UdDepthInput;
+	OutParameters.UdInvDeviceZToWorldZTransform = Frame.InvDeviceZToWorldZTransform;
+	OutParameters.UdLogDepthScale = Frame.LogDepthScale;
+	OutParameters.UdReversedDepth = Frame.bReversedDepth ? 1.0f : 0.0f;
+	OutParameters.UdViewMin = InData.OutputViewport.Rect.Min;
+}
+
+static void AddCompositeTileListPass(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FUdsData& InData, FRDGTextureRef InOutput, FRDGBufferSRVRef InTileList, int32 InOffset, int32 InCount, bool bInCopyOnly)
+{
+	if (InCount <= 0)
+		return;
+
+	const FIntRect ViewRect = InData.OutputViewport.Rect;
+	const FIntVector GroupCount(FMath::Min(InCount, FUdsCompositeTileListCS::MaxGroupsX), FMath::DivideAndRoundUp(InCount, FUdsCompositeTileListCS::MaxGroupsX), 1);
+
+	FUdsCompositeTileListCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsCompositeTileListCS::FParameters>();
+	SetCompositeParameters(PassParameters->Composite, View, InData);
+	PassParameters->RWOutputTexture = GraphBuilder.CreateUAV(InOutput);
+	PassParameters->TileList = InTileList;
+	PassParameters->OutputViewMin = ViewRect.Min;
+	PassParameters->OutputViewMax = ViewRect.Max;
+	PassParameters->TileListOffset = InOffset;
+	PassParameters->TileCount = InCount;
+	PassParameters->TileGroupsX = GroupCount.X;
+
+	FUdsCompositeTileListCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FUdsCompositeTileListCS::FCopyOnlyDim>(bInCopyOnly);
+	TShaderMapRef<FUdsCompositeTileListCS> ComputeShader(View.ShaderMap, PermutationVector);
+
+	FComputeShaderUtils::AddPass(GraphBuilder,
+		RDG_EVENT_NAME("UdsSubpassComposite (CS, %s) %d tiles", bInCopyOnly ? TEXT("copy") : TEXT("composite"), InCount),
+		ComputeShader, PassParameters,
+		GroupCount
+	);
+}
+
 void FUdsSubpassComposite::ParseEnvironment(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FInputs& PassInputs)
 {
-	Data->bEnabled = GUdsComposite > 0;// && Data->UdColorTexture&& Data->UdDepthTexture;
+	Data->bEnabled = GUdsComposite > 0 && Data->UdColorTexture.IsValid() && Data->UdDepthTexture.IsValid() && Data->ViewState.IsValid();
 }
 
 void FUdsSubpassComposite::CreateResources(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FInputs& PassInputs)
@@ -50,6 +220,8 @@ void FUdsSubpassComposite::CreateResources(FRDGBuilder& GraphBuilder, const FVie
 		//Data->SceneDepthTexture = GraphBuilder.RegisterExternalTexture(SceneContext.EditorPrimitivesDepth, ERenderTargetTexture::Targetable);
 		//Data->SceneDepthTexture = GraphBuilder.RegisterExternalTexture(SceneContext.EditorPrimitivesDepth);
 		Data->CurrentInputTexture = PassInputs.SceneColor.Texture;
+		Data->UdColorInput = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(Data->UdColorTexture, TEXT("UdColorTexture")));
+		Data->UdDepthInput = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(Data->UdDepthTexture, TEXT("UdDepthTexture")));
 
 		Data->OutputViewport = FScreenPassTextureViewport(PassInputs.SceneColor);
 		Data->InputViewport = FScreenPassTextureViewport(PassInputs.SceneColor);
@@ -62,25 +234,73 @@ void FUdsSubpassComposite::PostProcess(FRDGBuilder& GraphBuilder, const FViewInf
 	{
 		FScreenPassRenderTarget Output = PassInputs.OverrideOutput;
 
-		FUdsCompositePS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsCompositePS::FParameters>();
+		const bool bCompute = GUdsCompositeCompute > 0 && EnumHasAnyFlags(Output.Texture->Desc.Flags, TexCreate_UAV);
+		const FIntRect ViewRect = Data->OutputViewport.Rect;
+
+		TArray<uint32> Tiles;
+		const int32 CoveredTiles = bCompute ? BuildCompositeTileList(*Data->ViewState, Data->UdColorTexture->GetSizeXY(), ViewRect.Size(), Tiles) : INDEX_NONE;
+
+		if (CoveredTiles != INDEX_NONE)
+		{
+			const int32 EmptyTiles = Tiles.Num() - CoveredTiles;
+			SET_DWORD_STAT(STAT_UdsCompositeTiles, CoveredTiles);
+			SET_DWORD_STAT(STAT_UdsCompositeTilesSkipped, EmptyTiles);
+
+			FRDGBufferRef TileBuffer = CreateStructuredBuffer(GraphBuilder, TEXT("UdsCompositeTiles"), sizeof(uint32), Tiles.Num(), Tiles.GetData(), Tiles.Num() * sizeof(uint32));
+			FRDGBufferSRVRef TileList = GraphBuilder.CreateSRV(TileBuffer);
 
-		PassParameters->Composite.InputTexture = Data->CurrentInputTexture;
-		PassParameters->Composite.DepthTexture = Data->SceneDepthTexture;
-		PassParameters->Composite.UdColorTexture = Data->UdColorTexture->GetTexture2D();
-		PassParameters->Composite.UdDepthTexture = Data->UdDepthTexture->GetTexture2D();
+			// a plain copy of the scene color is cheaper than a dispatch over the empty tiles, when the formats allow it
+			const FRDGTextureDesc& InputDesc = Data->CurrentInputTexture->Desc;
+			if (EmptyTiles > 0 && InputDesc.Format == Output.Texture->Desc.Format && InputDesc.Extent == Output.Texture->Desc.Extent)
+			{
+				AddCopyTexturePass(GraphBuilder, Data->CurrentInputTexture, Output.Texture);
+			}
+			else
+			{
+				AddCompositeTileListPass(GraphBuilder, View, *Data, Output.Texture, TileList, CoveredTiles, EmptyTiles, true);
+			}
+			AddCompositeTileListPass(GraphBuilder, View, *Data, Output.Texture, TileList, 0, CoveredTiles, false);
+		}
+		else if (bCompute)
+		{
+			FUdsCompositeCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsCompositeCS::FParameters>();
+			SetCompositeParameters(PassParameters->Composite, View, *Data);
+			PassParameters->RWOutputTexture = GraphBuilder.CreateUAV(Output.Texture);
+			PassParameters->OutputViewMin = ViewRect.Min;
+			PassParameters->OutputViewMax = ViewRect.Max;
 
-		PassParameters->RenderTargets[0] = FRenderTargetBinding(Output.Texture, ERenderTargetLoadAction::ENoAction);
+			TShaderMapRef<FUdsCompositeCS> ComputeShader(View.ShaderMap);
 
-		TShaderMapRef<FUdsCompositePS> PixelShader(View.ShaderMap);
+			FComputeShaderUtils::AddPass(GraphBuilder,
+				RDG_EVENT_NAME("UdsSubpassComposite (CS) %dx%d", ViewRect.Width(), ViewRect.Height()),
+				ComputeShader, PassParameters,
+				FComputeShaderUtils::GetGroupCount(ViewRect.Size(), FUdsCompositeCS::TileSize)
+			);
+		}
+		else
+		{
+			FUdsCompositePS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsCompositePS::FParameters>();
+			SetCompositeParameters(PassParameters->Composite, View, *Data);
 
-		AddDrawScreenPass(GraphBuilder,
-			RDG_EVENT_NAME("UdsSubpassComposite (PS)"),
-			View, Data->OutputViewport, Data->InputViewport,
-			PixelShader, PassParameters,
-			EScreenPassDrawFlags::None
-		);
+			PassParameters->RenderTargets[0] = FRenderTargetBinding(Output.Texture, ERenderTargetLoadAction::ENoAction);
+
+			TShaderMapRef<FUdsCompositePS> PixelShader(View.ShaderMap);
+
+			AddDrawScreenPass(GraphBuilder,
+				RDG_EVENT_NAME("UdsSubpassComposite (PS)"),
+				View, Data->OutputViewport, Data->InputViewport,
+				PixelShader, PassParameters,
+				EScreenPassDrawFlags::None
+			);
+		}
 
 		Data->FinalOutput = Output;
 		Data->CurrentInputTexture = Output.Texture;
 	}
+	else if (PassInputs.OverrideOutput.IsValid())
+	{
+		// this view has no UDS image (yet), the output still has to receive the scene color
+		AddDrawTexturePass(GraphBuilder, View, PassInputs.SceneColor, PassInputs.OverrideOutput);
+		Data->FinalOutput = PassInputs.OverrideOutput;
+	}
 }
\ No newline at end of file
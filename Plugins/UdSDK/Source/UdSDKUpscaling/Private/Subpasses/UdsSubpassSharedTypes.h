@@ -3,8 +3,43 @@
 #include "ShaderParameterMacros.h"
 
 BEGIN_SHADER_PARAMETER_STRUCT(FCompositePassParameters, )
+	SHADER_PARAMETER_STRUCT_REF(FViewUniformShaderParameters, View)
 	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, InputTexture)
 	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, DepthTexture)
-	SHADER_PARAMETER_TEXTURE(Texture2D, UdColorTexture)
-	SHADER_PARAMETER_TEXTURE(Texture2D, UdDepthTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdColorTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdDepthTexture)
+	SHADER_PARAMETER(FVector4, UdInvDeviceZToWorldZTransform)
+	SHADER_PARAMETER(float, UdLogDepthScale)
+	SHADER_PARAMETER(float, UdReversedDepth)
+	SHADER_PARAMETER(FIntPoint, UdViewMin)
+END_SHADER_PARAMETER_STRUCT()
+
+BEGIN_SHADER_PARAMETER_STRUCT(FUpscalePassParameters, )
+	SHADER_PARAMETER_STRUCT_REF(FViewUniformShaderParameters, View)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, DepthTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdColorTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdDepthTexture)
+	SHADER_PARAMETER(FVector2D, UdInputSize)
+	SHADER_PARAMETER(FVector2D, UdInputScale)
+	SHADER_PARAMETER(float, DepthThreshold)
+	SHADER_PARAMETER(FVector4, UdInvDeviceZToWorldZTransform)
+	SHADER_PARAMETER(float, UdLogDepthScale)
+	SHADER_PARAMETER(float, UdReversedDepth)
+	SHADER_PARAMETER(FIntPoint, UdViewMin)
+END_SHADER_PARAMETER_STRUCT()
+
+BEGIN_SHADER_PARAMETER_STRUCT(FTemporalPassParameters, )
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdColorTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdDepthTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, HistoryColorTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, HistoryDepthTexture)
+	SHADER_PARAMETER(FMatrix, ClipToPrevClip)
+	SHADER_PARAMETER(FVector4, UdInvDeviceZToWorldZTransform)
+	SHADER_PARAMETER(float, UdLogDepthScale)
+	SHADER_PARAMETER(float, UdReversedDepth)
+	SHADER_PARAMETER(FIntPoint, TemporalFactor)
+	SHADER_PARAMETER(FIntPoint, TemporalPhase)
+	SHADER_PARAMETER(FVector2D, TargetSize)
+	SHADER_PARAMETER(float, HistoryValid)
+	SHADER_PARAMETER(float, DepthThreshold)
 END_SHADER_PARAMETER_STRUCT()
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "UdsSubpassTemporal.h"
+#include "PixelShaderUtils.h"
+
+static float GUdsTemporalDepthThreshold = 0.05f;
+static FAutoConsoleVariableRef CVarUdsTemporalDepthThreshold(
+	TEXT("r.Uds.Temporal.DepthThreshold"),
+	GUdsTemporalDepthThreshold,
+	TEXT("Relative depth difference above which a reprojected history pixel counts as disoccluded and is rebuilt from the fresh pixels"),
+	ECVF_RenderThreadSafe);
+
+
+
+///
+/// PIXEL SHADER
+///
+class FUdsTemporalPS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsTemporalPS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsTemporalPS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FTemporalPassParameters, Temporal)
+		RENDER_TARGET_BINDING_SLOTS()
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUdsTemporalPS, "/Plugins/UdSDK/Private/Uds_Temporal.usf", "MainPS", SF_Pixel);
+
+void FUdsSubpassTemporal::Upscale(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FInputs& PassInputs)
+{
+	if (!Data->bEnabled || !Data->ViewState.IsValid())
+		return;
+
+	FUdViewState& ViewState = *Data->ViewState;
+	const FUdFrameInfo& Frame = ViewState.PresentedFrame_RenderThread;
+	if (Frame.TemporalFactor == FIntPoint(1, 1))
+	{
+		ViewState.HistoryColor.SafeRelease();
+		ViewState.HistoryDepth.SafeRelease();
+		return;
+	}
+
+	const FIntPoint InputSize = Data->UdColorInput->Desc.Extent;
+	const FIntPoint OutputSize = Frame.TargetSize;
+	if (InputSize * Frame.TemporalFactor != OutputSize)
+		return;
+
+	const bool bHistoryValid = ViewState.HistoryColor.IsValid() && ViewState.HistoryDepth.IsValid()
+		&& ViewState.HistoryColor->GetDesc().Extent == OutputSize;
+
+	// udSDK has not delivered anything new since the last reconstruction, the history is the answer
+	if (bHistoryValid && ViewState.HistoryFrameNumber == Frame.FrameNumber)
+	{
+		Data->UdColorInput = GraphBuilder.RegisterExternalTexture(ViewState.HistoryColor, TEXT("UdColorHistory"));
+		Data->UdDepthInput = GraphBuilder.RegisterExternalTexture(ViewState.HistoryDepth, TEXT("UdDepthHistory"));
+		return;
+	}
+
+	FRDGTextureDesc ColorDesc = FRDGTextureDesc::Create2D(OutputSize, PF_B8G8R8A8, FClearValueBinding::Black, TexCreate_ShaderResource | TexCreate_RenderTargetable);
+	FRDGTextureDesc DepthDesc = FRDGTextureDesc::Create2D(OutputSize, PF_R32_FLOAT, FClearValueBinding::White, TexCreate_ShaderResource | TexCreate_RenderTargetable);
+	FRDGTextureRef TemporalColor = GraphBuilder.CreateTexture(ColorDesc, TEXT("UdColorTemporal"));
+	FRDGTextureRef TemporalDepth = GraphBuilder.CreateTexture(DepthDesc, TEXT("UdDepthTemporal"));
+
+	FUdsTemporalPS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsTemporalPS::FParameters>();
+
+	PassParameters->Temporal.UdColorTexture = Data->UdColorInput;
+	PassParameters->Temporal.UdDepthTexture = Data->UdDepthInput;
+	// without history the shader never reads these, they only need to be bound
+	PassParameters->Temporal.HistoryColorTexture = bHistoryValid ? GraphBuilder.RegisterExternalTexture(ViewState.HistoryColor, TEXT("UdColorHistory")) : Data->UdColorInput;
+	PassParameters->Temporal.HistoryDepthTexture = bHistoryValid ? GraphBuilder.RegisterExternalTexture(ViewState.HistoryDepth, TEXT("UdDepthHistory")) : Data->UdDepthInput;
+	PassParameters->Temporal.ClipToPrevClip = Frame.ViewProjection.Inverse() * ViewState.HistoryViewProjection;
+	PassParameters->Temporal.UdInvDeviceZToWorldZTransform = Frame.InvDeviceZToWorldZTransform;
+	PassParameters->Temporal.UdLogDepthScale = Frame.LogDepthScale;
+	PassParameters->Temporal.UdReversedDepth = Frame.bReversedDepth ? 1.0f : 0.0f;
+	PassParameters->Temporal.TemporalFactor = Frame.TemporalFactor;
+	PassParameters->Temporal.TemporalPhase = Frame.TemporalPhase;
+	PassParameters->Temporal.TargetSize = FVector2D(OutputSize.X, OutputSize.Y);
+	PassParameters->Temporal.HistoryValid = bHistoryValid ? 1.0f : 0.0f;
+	PassParameters->Temporal.DepthThreshold = GUdsTemporalDepthThreshold;
+
+	PassParameters->RenderTargets[0] = FRenderTargetBinding(TemporalColor, ERenderTargetLoadAction::ENoAction);
+	PassParameters->RenderTargets[1] = FRenderTargetBinding(TemporalDepth, ERenderTargetLoadAction::ENoAction);
+
+	TShaderMapRef<FUdsTemporalPS> PixelShader(View.ShaderMap);
+
+	FPixelShaderUtils::AddFullscreenPass(GraphBuilder,
+		View.ShaderMap,
+		RDG_EVENT_NAME("UdsSubpassTemporal (PS) %dx%d phase %d,%d", OutputSize.X, OutputSize.Y, Frame.TemporalPhase.X, Frame.TemporalPhase.Y),
+		PixelShader, PassParameters,
+		FIntRect(FIntPoint::ZeroValue, OutputSize)
+	);
+
+	// the reconstruction is next frame's history
+	GraphBuilder.QueueTextureExtraction(TemporalColor, &ViewState.HistoryColor);
+	GraphBuilder.QueueTextureExtraction(TemporalDepth, &ViewState.HistoryDepth);
+	ViewState.HistoryViewProjection = Frame.ViewProjection;
+	ViewState.HistoryFrameNumber = Frame.FrameNumber;
+
+	Data->UdColorInput = TemporalColor;
+	Data->UdDepthInput = TemporalDepth;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "UdsSubpass.h"
+
+class FUdsSubpassTemporal : public FUdsSubpass
+{
+public:
+	void Upscale(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FInputs& PassInputs) override;
+};
@@ -0,0 +1,85 @@
+#include "UdsSubpassUpscale.h"
+#include "PixelShaderUtils.h"
+
+static float GUdsUpscaleDepthThreshold = 0.05f;
+static FAutoConsoleVariableRef CVarUdsUpscaleDepthThreshold(
+	TEXT("r.Uds.Upscale.DepthThreshold"),
+	GUdsUpscaleDepthThreshold,
+	TEXT("Relative depth range inside a 2x2 UDS footprint above which the upscale stops blending and follows the scene depth"),
+	ECVF_RenderThreadSafe);
+
+
+
+///
+/// PIXEL SHADER
+///
+class FUdsUpscalePS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsUpscalePS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsUpscalePS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FUpscalePassParameters, Upscale)
+		RENDER_TARGET_BINDING_SLOTS()
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUdsUpscalePS, "/Plugins/UdSDK/Private/Uds_Upscale.usf", "MainPS", SF_Pixel);
+
+void FUdsSubpassUpscale::Upscale(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FInputs& PassInputs)
+{
+	if (!Data->bEnabled)
+		return;
+
+	const FUdFrameInfo& Frame = Data->ViewState->PresentedFrame_RenderThread;
+
+	const FIntPoint InputSize = Data->UdColorInput->Desc.Extent;
+	// the capture sized the UDS image from the same rect, and the composite samples it from ViewRect.Min
+	const FIntPoint OutputSize = View.ViewRect.Size();
+	if (InputSize == OutputSize || InputSize.X <= 0 || InputSize.Y <= 0)
+		return;
+
+	FRDGTextureDesc ColorDesc = FRDGTextureDesc::Create2D(OutputSize, PF_B8G8R8A8, FClearValueBinding::Black, TexCreate_ShaderResource | TexCreate_RenderTargetable);
+	FRDGTextureDesc DepthDesc = FRDGTextureDesc::Create2D(OutputSize, PF_R32_FLOAT, FClearValueBinding::White, TexCreate_ShaderResource | TexCreate_RenderTargetable);
+	FRDGTextureRef UpscaledColor = GraphBuilder.CreateTexture(ColorDesc, TEXT("UdColorUpscaled"));
+	FRDGTextureRef UpscaledDepth = GraphBuilder.CreateTexture(DepthDesc, TEXT("UdDepthUpscaled"));
+
+	FUdsUpscalePS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsUpscalePS::FParameters>();
+
+	PassParameters->Upscale.View = View.ViewUniformBuffer;
+	PassParameters->Upscale.DepthTexture = Data->SceneDepthTexture;
+	PassParameters->Upscale.UdColorTexture = Data->UdColorInput;
+	PassParameters->Upscale.UdDepthTexture = Data->UdDepthInput;
+	PassParameters->Upscale.UdInputSize = FVector2D(InputSize.X, InputSize.Y);
+	PassParameters->Upscale.UdInputScale = FVector2D(InputSize.X / (float)OutputSize.X, InputSize.Y / (float)OutputSize.Y);
+	PassParameters->Upscale.DepthThreshold = GUdsUpscaleDepthThreshold;
+	PassParameters->Upscale.UdInvDeviceZToWorldZTransform = Frame.InvDeviceZToWorldZTransform;
+	PassParameters->Upscale.UdLogDepthScale = Frame.LogDepthScale;
+	PassParameters->Upscale.UdReversedDepth = Frame.bReversedDepth ? 1.0f : 0.0f;
+	PassParameters->Upscale.UdViewMin = View.ViewRect.Min;
+
+	PassParameters->RenderTargets[0] = FRenderTargetBinding(UpscaledColor, ERenderTargetLoadAction::ENoAction);
+	PassParameters->RenderTargets[1] = FRenderTargetBinding(UpscaledDepth, ERenderTargetLoadAction::ENoAction);
+
+	TShaderMapRef<FUdsUpscalePS> PixelShader(View.ShaderMap);
+
+	FPixelShaderUtils::AddFullscreenPass(GraphBuilder,
+		View.ShaderMap,
+		RDG_EVENT_NAME("UdsSubpassUpscale (PS) %dx%d -> %dx%d", InputSize.X, InputSize.Y, OutputSize.X, OutputSize.Y),
+		PixelShader, PassParameters,
+		FIntRect(FIntPoint::ZeroValue, OutputSize)
+	);
+
+	// the composite now samples the full resolution reconstruction
+	Data->UdColorInput = UpscaledColor;
+	Data->UdDepthInput = UpscaledDepth;
+}
@@ -1,5 +1,6 @@
 #include "UdSDKComposite.h"
 #include "Runtime/RHI/Public/RHI.h"
+#include "DynamicRHI.h"
 #include "ImageUtils.h"
 #include "Slate/SceneViewport.h"
 #include "Engine/GameViewportClient.h"
@@ -7,9 +8,177 @@
 #include "UdSDKCompositeViewExtension.h"
 #include "UdSDKDefine.h"
 #include "Utils/CThreadPool.h"
+#include "UdSDKStats.h"
+#include "UdSDKDepthKernels.h"
+#include "UdSDKInstanceCulling.h"
+#include "UdSDKInstanceBVH.h"
+#include "Async/Async.h"
+#include "Misc/Paths.h"
+#include "Misc/Crc.h"
 
 uint32 CUdSDKComposite::SelectColor = 0xff0071c1;
 
+static TAutoConsoleVariable<int32> CVarUdsAsyncRender(
+	TEXT("r.Uds.AsyncRender"),
+	1,
+	TEXT("Render the UDS image on a dedicated worker thread, one frame behind the game thread = 1 or 0"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsZeroCopyUpload(
+	TEXT("r.Uds.ZeroCopyUpload"),
+	0,
+	TEXT("Let udSDK render straight into a ring of locked dynamic textures instead of uploading the bulk buffers = 1 or 0"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsViewStateTimeout(
+	TEXT("r.Uds.ViewStateTimeout"),
+	120,
+	TEXT("Number of frames a view may go without rendering before its UDS render target and textures are released"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarUdsResolutionScale(
+	TEXT("r.Uds.ResolutionScale"),
+	1.0f,
+	TEXT("Fraction of the view resolution the UDS image is rendered at, the upscale subpass restores full resolution (0.25 - 1.0)"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarUdsResolutionScaleTargetMs(
+	TEXT("r.Uds.ResolutionScale.TargetMs"),
+	0.0f,
+	TEXT("When > 0, adjust the UDS resolution scale per view so udRenderContext_Render takes about this many milliseconds"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarUdsResolutionScaleMin(
+	TEXT("r.Uds.ResolutionScale.Min"),
+	0.5f,
+	TEXT("Lowest resolution scale the automatic mode may pick"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsTemporal(
+	TEXT("r.Uds.Temporal"),
+	0,
+	TEXT("Render only part of the UDS pixels each frame and reconstruct the rest from reprojected history\n")
+	TEXT(" 0: off\n")
+	TEXT(" 1: 2x1 interleave, half the pixels per frame\n")
+	TEXT(" 2: 2x2 interleave, a quarter of the pixels per frame"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsRenderTiles(
+	TEXT("r.Uds.RenderTiles"),
+	1,
+	TEXT("Split the UDS image into this many horizontal bands rendered concurrently on the thread pool, 1 renders it in a single call"),
+	ECVF_Default);
+
+static const int MaxRenderTiles = 32;
+
+static TAutoConsoleVariable<int32> CVarUdsMaxConcurrentLoads(
+	TEXT("r.Uds.MaxConcurrentLoads"),
+	4,
+	TEXT("How many udPointCloud_Load calls may run on the thread pool at the same time, the rest wait nearest first"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsCompositeTileMask(
+	TEXT("r.Uds.Composite.TileMask"),
+	1,
+	TEXT("Mark the 8x8 tiles of each UDS image that hold any point on the CPU, the composite then skips the others = 1 or 0.\n")
+	TEXT("Not built with r.Uds.ZeroCopyUpload or r.Uds.Temporal"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsSkipUnchangedFrames(
+	TEXT("r.Uds.SkipUnchangedFrames"),
+	1,
+	TEXT("Keep the last UDS textures instead of rendering and uploading again while the camera, the instances, the selection and the streamer are all still = 1 or 0.\n")
+	TEXT("Needs r.Uds.Streamer.ManualUpdate 1 to know when streaming has settled"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsCulling(
+	TEXT("r.Uds.Culling"),
+	1,
+	TEXT("Leave the instances outside the view frustum or beyond their max draw distance out of udRenderContext_Render = 1 or 0"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsCullingBVHMinInstances(
+	TEXT("r.Uds.Culling.BVHMinInstances"),
+	1024,
+	TEXT("From this many rendered instances the views cull through the instance BVH instead of testing every instance, 0 to never use it"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsLogarithmicDepth(
+	TEXT("r.Uds.LogarithmicDepth"),
+	0,
+	TEXT("Render UDS depth with udRCF_LogarithmicDepth and a far plane of r.Uds.LogarithmicDepth.FarPlane for precision over very large worlds = 1 or 0.\n")
+	TEXT("r.Uds.Temporal is ignored while it is on"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarUdsLogarithmicDepthFarPlane(
+	TEXT("r.Uds.LogarithmicDepth.FarPlane"),
+	100000000.0f,
+	TEXT("Far plane in world units of the UDS projection when r.Uds.LogarithmicDepth is on, nothing beyond it is drawn"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsDepthFormat(
+	TEXT("r.Uds.DepthFormat"),
+	0,
+	TEXT("Format the UDS depth is uploaded in, ignored with r.Uds.ZeroCopyUpload\n")
+	TEXT(" 0: PF_R32_FLOAT, the depth as udSDK wrote it\n")
+	TEXT(" 1: PF_R16F, converted to reversed Z on the CPU first so the precision is spent near the camera, half the upload"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsStreamerManualUpdate(
+	TEXT("r.Uds.Streamer.ManualUpdate"),
+	1,
+	TEXT("Render with udRCF_ManualStreamerUpdate and update the udSDK streamer on a background thread instead of inside every render = 1 or 0.\n")
+	TEXT("The streamer stats and r.Uds.Streamer.MemoryBudgetMB only work with 1"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsStreamerUpdateIntervalMs(
+	TEXT("r.Uds.Streamer.UpdateIntervalMs"),
+	16,
+	TEXT("Milliseconds between two udStreamer_Update calls of the background streamer thread"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarUdsStreamerMemoryBudgetMB(
+	TEXT("r.Uds.Streamer.MemoryBudgetMB"),
+	0,
+	TEXT("When > 0 and the streamer holds more than this, the farthest point clouds stop being rendered, so they stop requesting data, until it is back under budget"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarUdsHiddenEvictSeconds(
+	TEXT("r.Uds.Streamer.HiddenEvictSeconds"),
+	10.0f,
+	TEXT("Over r.Uds.Streamer.MemoryBudgetMB, the model of an instance hidden for at least this long is unloaded, longest hidden first,\n")
+	TEXT("before any visible instance is parked. Showing it again reloads it"),
+	ECVF_Default);
+
+// the streamer needs a few updates to react to a change of the render list, step the budget slower than that
+static const double BudgetStepSeconds = 0.25;
+// back under this fraction of the budget before a parked instance is rendered again
+static const double BudgetResumeFraction = 0.85;
+// the pending loads are re-ranked by distance once the camera is this far from where they were last ranked
+static const float UdLoadResortDistance = 1000.0f;
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Upload Bytes Copied"), STAT_UdsUploadBytesCopied, STATGROUP_UdSDK);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Upload Bytes Saved"), STAT_UdsUploadBytesSaved, STATGROUP_UdSDK);
+DECLARE_CYCLE_STAT(TEXT("Pack Depth"), STAT_UdsPackDepth, STATGROUP_UdSDK);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Render Tiles"), STAT_UdsRenderTiles, STATGROUP_UdSDK);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Render Time (ms)"), STAT_UdsRenderTimeMs, STATGROUP_UdSDK);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pending Loads"), STAT_UdsPendingLoads, STATGROUP_UdSDK);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Active Loads"), STAT_UdsActiveLoads, STATGROUP_UdSDK);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Streamer Memory (MB)"), STAT_UdsStreamerMemoryMB, STATGROUP_UdSDK);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Streamer Starved (ms)"), STAT_UdsStreamerStarvedMs, STATGROUP_UdSDK);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Streamer Models Active"), STAT_UdsStreamerModelsActive, STATGROUP_UdSDK);
+DECLARE_CYCLE_STAT(TEXT("Build Tile Mask"), STAT_UdsBuildTileMask, STATGROUP_UdSDK);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Budget Parked Instances"), STAT_UdsBudgetParkedInstances, STATGROUP_UdSDK);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Hidden Instances"), STAT_UdsHiddenInstances, STATGROUP_UdSDK);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Culled Instances"), STAT_UdsCulledInstances, STATGROUP_UdSDK);
+DECLARE_CYCLE_STAT(TEXT("Cull Instances"), STAT_UdsCullInstances, STATGROUP_UdSDK);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Skipped Frames"), STAT_UdsSkippedFrames, STATGROUP_UdSDK);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Instance BVH Height"), STAT_UdsBVHHeight, STATGROUP_UdSDK);
+DECLARE_CYCLE_STAT(TEXT("Instance Queries"), STAT_UdsInstanceQueries, STATGROUP_UdSDK);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hidden Models Evicted"), STAT_UdsHiddenModelsEvicted, STATGROUP_UdSDK);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cached Models"), STAT_UdsCachedModels, STATGROUP_UdSDK);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Model Cache Hits"), STAT_UdsModelCacheHits, STATGROUP_UdSDK);
+
 template <typename ValueType>
 void ResizeArray(TArray<ValueType>& Array, int32 Size)
 {
@@ -62,6 +231,18 @@ uint32_t vcVoxelShader_Colour(udPointCloud* pPointCloud, const udVoxelID* pVoxel
 	return vcPCShaders_BuildAlpha(pData) | (0xffffff & result);
 }
 
+FUdModel::~FUdModel()
+{
+	if (pPointCloud)
+	{
+		enum udError error = udPointCloud_Unload(&pPointCloud);
+		if (error != udE_Success)
+		{
+			UDSDK_ERROR_MSG("udPointCloud_Unload error : %s", GetError(error));
+		}
+	}
+}
+
 auto FuncMat2Array = [](double* array, const FMatrix& Mat)
 {
 	static bool transpose = false;
@@ -81,8 +262,6 @@ auto FuncMat2Array = [](double* array, const FMatrix& Mat)
 
 CUdSDKComposite::CUdSDKComposite()
 {
-	Width = 0;
-	Height = 0;
 	LoginFlag = false;
 	ViewExtension = nullptr;
 	int32 NumberOfCores = FPlatformMisc::NumberOfCores();
@@ -160,7 +339,7 @@ int CUdSDKComposite::Login()
 
 	{
 		FScopeLock ScopeLockInst(&DataMutex);
-		InstanceArray.Reset();
+		ResetInstances();
 	}
 	//AssetArray.Reset();
 	
@@ -194,6 +373,9 @@ int CUdSDKComposite::Login()
 		return error;
 	}
 
+	bManualStreamerUpdate = CVarUdsStreamerManualUpdate.GetValueOnGameThread() > 0;
+	StreamerWorker.start([] { return CVarUdsStreamerUpdateIntervalMs.GetValueOnAnyThread(); }, [this] { UpdateStreamer(); });
+
 	if (!ViewExtension)
 	{
 		ViewExtension = FSceneViewExtensions::NewExtension<FUdSDKCompositeViewExtension>();
@@ -228,37 +410,46 @@ int CUdSDKComposite::Exit()
 	Password = "";
 	Offline = false;
 
-	Width = 0;
-	Height = 0;
-
 	if (LoginFlag)
 	{
 		LoginFlag = false;
+		CancelAllLoads();
+		// the worker still uses pRenderer, the view render targets and the loaded point clouds
+		RenderWorker.wait();
+		StreamerWorker.stop();
+		BudgetParkedCount = 0;
+		for (auto& Pair : ViewStates)
 		{
-			FScopeLock ScopeLock(&DataMutex);
-			for (auto inst : InstanceArray)
+			DestroyViewState(Pair.Value);
+		}
+		ViewStates.Reset();
+
+		for (udRenderContext*& pTileRenderer : TileRenderers)
+		{
+			error = udRenderContext_Destroy(&pTileRenderer);
+			if (error != udE_Success)
 			{
-				error = udPointCloud_Unload(&inst.pPointCloud);
-				if (error != udE_Success)
-				{
-					UDSDK_ERROR_MSG("udPointCloud_Unload error : %s", GetError(error));
-				}
+				UDSDK_ERROR_MSG("udRenderContext_Destroy error : %s", GetError(error));
 			}
-			InstanceArray.Reset();
+		}
+		TileRenderers.Reset();
+
+		{
+			// the view states held the last snapshots, dropping the table unloads every point cloud
+			FScopeLock ScopeLock(&DataMutex);
+			PublishedSnapshot.reset();
+			ResetInstances();
+			PendingTransforms.Empty();
 
 			AssetsMap.Reset();
 		}
-		
 
-		if (pRenderView)
 		{
-			error = udRenderTarget_Destroy(&pRenderView);
-			if (error != udE_Success)
-			{
-				UDSDK_ERROR_MSG("udRenderTarget_Destroy error : %s", GetError(error));
-			}
-			pRenderView = nullptr;
+			FScopeLock ScopeLock(&ModelCacheMutex);
+			ModelCache.Reset();
+			SET_DWORD_STAT(STAT_UdsCachedModels, 0);
 		}
+		
 
 		if (pRenderer)
 		{
@@ -285,7 +476,7 @@ int CUdSDKComposite::Exit()
 	return error;
 }
 //PRAGMA_DISABLE_OPTIMIZATION
-int CUdSDKComposite::Load(uint32 InUniqueID, TSharedPtr<FUdAsset> OutAssert)
+int CUdSDKComposite::Load(uint32 InUniqueID, TSharedPtr<FUdAsset> OutAssert, const FUdLoadTokenPtr& InCancelToken)
 {
 	enum udError error = udE_Failure;
 
@@ -300,8 +491,13 @@ int CUdSDKComposite::Load(uint32 InUniqueID, TSharedPtr<FUdAsset> OutAssert)
 		if (AssetsMap.Contains(InUniqueID))
 		{
 			UDSDK_ERROR_MSG("1:AUdPointCloud creating udPointCloud instance already exists!");
+			// the published one keeps its point cloud, a second asset for the same ID gets none
+			if (AssetsMap.FindRef(InUniqueID) != OutAssert)
+				OutAssert->pPointCloud = nullptr;
 			return error;
 		}
+		// only set once the instance is published below, a failed load leaves nothing to dangle
+		OutAssert->pPointCloud = nullptr;
 	}
 
 	FString folder = OutAssert->folder;
@@ -321,18 +517,17 @@ int CUdSDKComposite::Load(uint32 InUniqueID, TSharedPtr<FUdAsset> OutAssert)
 		return error;
 	}
 
-	struct udPointCloudHeader header;
-	memset(&header, 0, sizeof(header));
-
-	struct udPointCloud* pModel = NULL;
-
-	error = udPointCloud_Load(pContext, &pModel, TCHAR_TO_UTF8(*uri), &header);
+	// the model may already be in for another actor, only the instance below is per actor
+	FUdModelPtr Model;
+	error = (udError)AcquireModel(uri, Model);
 	if (error != udE_Success)
 	{
-		UDSDK_ERROR_MSG("udPointCloud_Load error : %s %s", GetError(error), *uri);
 		return error;
 	}
 
+	struct udPointCloudHeader header = Model->Header;
+	struct udPointCloud* pModel = Model->pPointCloud;
+
 	//double maxDim = 0;
 	//for (int i = 0; i < 3; i++) {
 	//	if (maxDim < header.boundingBoxExtents[i])
@@ -389,8 +584,6 @@ int CUdSDKComposite::Load(uint32 InUniqueID, TSharedPtr<FUdAsset> OutAssert)
 	inst.pVoxelShader = vcVoxelShader_Black;
 	inst.pVoxelUserData = (void*)OutAssert.Get();
 
-	OutAssert->pPointCloud = pModel;
-
 	uint32_t attributeOffset;
 	if (udAttributeSet_GetOffsetOfStandardAttribute(&header.attributes, udSA_ARGB, &attributeOffset) == udE_Success)
 	{
@@ -402,24 +595,106 @@ int CUdSDKComposite::Load(uint32 InUniqueID, TSharedPtr<FUdAsset> OutAssert)
 		if (AssetsMap.Contains(InUniqueID))
 		{
 			UDSDK_ERROR_MSG("2:AUdPointCloud creating udPointCloud instance already exists!");
+			// dropping Model unloads the point cloud unless another instance uses it
+			if (AssetsMap.FindRef(InUniqueID) != OutAssert)
+				OutAssert->pPointCloud = nullptr;
+			return udE_Failure;
+		}
 
-			error = udPointCloud_Unload(&inst.pPointCloud);
-			if (error != udE_Success)
-			{
-				UDSDK_ERROR_MSG("Load->udPointCloud_Unload error : %s", GetError(error));
-			}
-
-			return error;
+		// removed while udPointCloud_Load was still talking to the server
+		if (InCancelToken && *InCancelToken)
+		{
+			return udE_NothingToDo;
 		}
 
+		FUdInstanceState State;
+		State.LocalCenter = FVector(header.boundingBoxCenter[0], header.boundingBoxCenter[1], header.boundingBoxCenter[2]);
+		State.LocalExtent = FVector(header.boundingBoxExtents[0], header.boundingBoxExtents[1], header.boundingBoxExtents[2]);
+
+		const int32 Index = InstanceArray.Num();
+		InstanceIndices.Add(InUniqueID, Index);
+		InstanceIds.Push(InUniqueID);
 		InstanceArray.Push(inst);
+		InstanceModels.Push(std::make_shared<FUdModelRef>(Model, OutAssert));
+		InstanceStates.Push(State);
+		InstanceProxies.Push(GetMutableInstanceBVH().CreateProxy(GetInstanceWorldBox(Index), Index));
 		AssetsMap.Add(InUniqueID, OutAssert);
+		OutAssert->pPointCloud = pModel;
+		++InstanceGeneration;
 	}
 
 	return error;
 }
 //PRAGMA_ENABLE_OPTIMIZATION
 
+FString CUdSDKComposite::NormalizeModelUrl(const FString& InUrl)
+{
+	FString Url = InUrl.TrimStartAndEnd();
+	const int32 SchemeEnd = Url.Find(TEXT("://"));
+	if (SchemeEnd == INDEX_NONE)
+	{
+		// a local file, spelled with either slash and possibly relative bits
+		FPaths::NormalizeFilename(Url);
+		FPaths::CollapseRelativeDirectories(Url);
+#if PLATFORM_WINDOWS
+		Url.ToLowerInline();
+#endif
+		return Url;
+	}
+
+	// scheme and host are case insensitive, the path is left alone
+	int32 HostEnd = Url.Find(TEXT("/"), ESearchCase::CaseSensitive, ESearchDir::FromStart, SchemeEnd + 3);
+	if (HostEnd == INDEX_NONE)
+		HostEnd = Url.Len();
+	return Url.Left(HostEnd).ToLower() + Url.Mid(HostEnd);
+}
+
+int CUdSDKComposite::AcquireModel(const FString& InUrl, FUdModelPtr& OutModel)
+{
+	const FString Key = NormalizeModelUrl(InUrl);
+
+	std::shared_ptr<FUdModelSlot> Slot;
+	{
+		FScopeLock ScopeLock(&ModelCacheMutex);
+		// slots of unloaded models nobody is loading into are dropped on the way
+		for (auto It = ModelCache.CreateIterator(); It; ++It)
+		{
+			if (It.Value()->Model.expired() && It.Value().use_count() == 1 && It.Key() != Key)
+				It.RemoveCurrent();
+		}
+		std::shared_ptr<FUdModelSlot>& Found = ModelCache.FindOrAdd(Key);
+		if (!Found)
+			Found = std::make_shared<FUdModelSlot>();
+		Slot = Found;
+		SET_DWORD_STAT(STAT_UdsCachedModels, ModelCache.Num());
+	}
+
+	// a second actor with the same url waits here for the first load instead of starting its own
+	FScopeLock SlotLock(&Slot->LoadMutex);
+	OutModel = Slot->Model.lock();
+	if (OutModel)
+	{
+		INC_DWORD_STAT(STAT_UdsModelCacheHits);
+		return udE_Success;
+	}
+
+	struct udPointCloudHeader header;
+	memset(&header, 0, sizeof(header));
+
+	struct udPointCloud* pModel = NULL;
+
+	enum udError error = udPointCloud_Load(pContext, &pModel, TCHAR_TO_UTF8(*InUrl), &header);
+	if (error != udE_Success)
+	{
+		UDSDK_ERROR_MSG("udPointCloud_Load error : %s %s", GetError(error), *InUrl);
+		return error;
+	}
+
+	OutModel = std::make_shared<FUdModel>(pModel, header);
+	Slot->Model = OutModel;
+	return error;
+}
+
 //int CUdSDKComposite::AsyncLoad(const TArray<TSharedPtr<FUdAsset>>& asserts)
 //{
 //	//FScopeLock ScopeLock(&CallMutex);
@@ -476,61 +751,267 @@ int CUdSDKComposite::AsyncLoad(uint32 InUniqueID, TSharedPtr<FUdAsset> OutAssert
 {
 	//FScopeLock ScopeLock(&CallMutex);
 
+	FUdLoadRequest Request;
+	Request.UniqueID = InUniqueID;
+	Request.Asset = OutAssert;
+	Request.Func = InFunc;
+	return LoadBatch({ Request });
+}
+
+int CUdSDKComposite::LoadBatch(const TArray<FUdLoadRequest>& InRequests, const FunLoadProgress& InProgress)
+{
 	enum udError error = udE_Failure;
 
 	if (!LoginFlag)
 	{
-		UDSDK_ERROR_MSG("AsyncLoad -> Not logged in!");
+		UDSDK_ERROR_MSG("LoadBatch -> Not logged in!");
 		return error;
 	}
 
-	uint32 UniqueID = InUniqueID;
-	TSharedPtr<FUdAsset> Assert = OutAssert;
-	const FunCP0& Func = InFunc;
-	CThreadPool::Get()->enqueue([UniqueID, Assert, Func, this] {
-		Load(UniqueID, Assert);
-		//FPlatformProcess::Sleep(0.025f);
-		if (Func)
-			Func();
-	});
+	std::shared_ptr<FUdLoadBatch> Batch = std::make_shared<FUdLoadBatch>();
+	Batch->Total = InRequests.Num();
+	Batch->Progress = InProgress;
 
+	TArray<FUdPendingLoad> SupersededLoads;
+	{
+		FScopeLock ScopeLock(&LoadMutex);
+		for (const FUdLoadRequest& Request : InRequests)
+		{
+			if (!Request.Asset.IsValid())
+			{
+				UDSDK_ERROR_MSG("LoadBatch -> Asset is NULL : %d", Request.UniqueID);
+				Batch->Total--;
+				continue;
+			}
+
+			FUdPendingLoad Load;
+			Load.Request = Request;
+			Load.Batch = Batch;
+			PushPendingLoad(MoveTemp(Load), SupersededLoads);
+		}
+	}
+
+	for (const FUdPendingLoad& Load : SupersededLoads)
+	{
+		FinishLoad(Load, udE_NothingToDo);
+	}
+	PumpLoads();
 	return udE_Success;
 }
 
-int CUdSDKComposite::Remove(uint32 InUniqueID)
+void CUdSDKComposite::PushPendingLoad(FUdPendingLoad&& InLoad, TArray<FUdPendingLoad>& OutSuperseded)
 {
-	FScopeLock ScopeLock(&DataMutex);
-	enum udError error = udE_Success;
-	void* pPointCloud = nullptr;
-	if (TSharedPtr<FUdAsset> Asset = AssetsMap.FindRef(InUniqueID))
+	// LoadMutex is held by the caller, who finishes OutSuperseded once it has let go of it.
+	// A newer load for the same actor replaces the older one, which would otherwise keep
+	// running untracked and publish its instance after the actor was removed
+	CancelLoadLocked(InLoad.Request.UniqueID, OutSuperseded);
+	if (PendingLoads.Num() == 0)
+	{
+		PendingLoadsOrigin = LastViewOrigin;
+	}
+	InLoad.CancelToken = std::make_shared<std::atomic<bool>>(false);
+	InLoad.DistSquared = FVector::DistSquared(InLoad.Request.Asset->coords, PendingLoadsOrigin);
+	LoadTokens.Add(InLoad.Request.UniqueID, InLoad.CancelToken);
+	PendingLoads.HeapPush(MoveTemp(InLoad));
+}
+
+void CUdSDKComposite::PumpLoads()
+{
+	const int MaxLoads = FMath::Max(1, CVarUdsMaxConcurrentLoads.GetValueOnAnyThread());
+
+	FScopeLock ScopeLock(&LoadMutex);
+	if (PendingLoads.Num() > 0 && FVector::DistSquared(LastViewOrigin, PendingLoadsOrigin) > FMath::Square(UdLoadResortDistance))
 	{
-		if (Asset->pPointCloud)
+		// the camera has moved on since the distances were taken, re-rank the whole queue once
+		PendingLoadsOrigin = LastViewOrigin;
+		for (FUdPendingLoad& Load : PendingLoads)
 		{
-			pPointCloud = Asset->pPointCloud;
+			Load.DistSquared = FVector::DistSquared(Load.Request.Asset->coords, PendingLoadsOrigin);
 		}
-		AssetsMap.Remove(InUniqueID);
+		PendingLoads.Heapify();
 	}
-	if (pPointCloud)
+
+	while (ActiveLoads < MaxLoads && PendingLoads.Num() > 0)
+	{
+		FUdPendingLoad Load;
+		PendingLoads.HeapPop(Load, false);
+		ActiveLoads++;
+
+		// behind any remove/select already queued for this actor
+		ActorExecutor.submit(Load.Request.UniqueID, [this, Load] {
+			RunLoad(Load);
+		});
+	}
+
+	SET_DWORD_STAT(STAT_UdsPendingLoads, PendingLoads.Num());
+	SET_DWORD_STAT(STAT_UdsActiveLoads, ActiveLoads);
+}
+
+void CUdSDKComposite::RunLoad(const FUdPendingLoad& InLoad)
+{
+	const FUdLoadRequest& Request = InLoad.Request;
+
+	enum udError error = udE_NothingToDo;
+	if (!*InLoad.CancelToken)
+	{
+		error = InLoad.bRestoreModel ? (udError)RestoreEvictedModel(Request.UniqueID) : (udError)Load(Request.UniqueID, Request.Asset, InLoad.CancelToken);
+	}
+
 	{
-		uint32 Index = 0;
-		for (auto inst : InstanceArray)
+		FScopeLock ScopeLock(&LoadMutex);
+		ActiveLoads--;
+		if (LoadTokens.FindRef(Request.UniqueID) == InLoad.CancelToken)
 		{
-			if (inst.pPointCloud == pPointCloud)
-			{
-				error = udPointCloud_Unload(&inst.pPointCloud);
-				if (error != udE_Success)
-				{
-					UDSDK_ERROR_MSG("udPointCloud_Unload error : %s", GetError(error));
-				}
-				break;
-			}
-			Index++;
+			LoadTokens.Remove(Request.UniqueID);
+		}
+	}
+
+	if (!*InLoad.CancelToken && Request.Func)
+		Request.Func();
+
+	FinishLoad(InLoad, *InLoad.CancelToken ? udE_NothingToDo : error);
+	PumpLoads();
+}
+
+void CUdSDKComposite::CancelLoad(uint32 InUniqueID)
+{
+	TArray<FUdPendingLoad> CancelledLoads;
+	{
+		FScopeLock ScopeLock(&LoadMutex);
+		CancelLoadLocked(InUniqueID, CancelledLoads);
+	}
+
+	for (const FUdPendingLoad& Load : CancelledLoads)
+	{
+		FinishLoad(Load, udE_NothingToDo);
+	}
+}
+
+void CUdSDKComposite::CancelLoadLocked(uint32 InUniqueID, TArray<FUdPendingLoad>& OutCancelled)
+{
+	// LoadMutex is held by the caller
+	FUdLoadTokenPtr CancelToken;
+	if (!LoadTokens.RemoveAndCopyValue(InUniqueID, CancelToken))
+		return;
+
+	// a running load notices the flag once udPointCloud_Load returns, a queued one never starts
+	*CancelToken = true;
+	const int32 NumCancelled = OutCancelled.Num();
+	for (int32 i = PendingLoads.Num() - 1; i >= 0; i--)
+	{
+		if (PendingLoads[i].CancelToken == CancelToken)
+		{
+			OutCancelled.Add(MoveTemp(PendingLoads[i]));
+			PendingLoads.RemoveAtSwap(i);
+		}
+	}
+	if (OutCancelled.Num() > NumCancelled)
+	{
+		PendingLoads.Heapify();
+	}
+}
+
+void CUdSDKComposite::CancelAllLoads()
+{
+	TArray<FUdPendingLoad> CancelledLoads;
+	{
+		FScopeLock ScopeLock(&LoadMutex);
+		for (auto& Pair : LoadTokens)
+		{
+			*Pair.Value = true;
 		}
-		InstanceArray.RemoveAt(Index);
+		LoadTokens.Reset();
+		CancelledLoads = MoveTemp(PendingLoads);
+		PendingLoads.Reset();
+	}
+
+	for (const FUdPendingLoad& Load : CancelledLoads)
+	{
+		FinishLoad(Load, udE_NothingToDo);
+	}
+}
+
+void CUdSDKComposite::FinishLoad(const FUdPendingLoad& InLoad, int InResult)
+{
+	if (InLoad.Request.OnFinished)
+		InLoad.Request.OnFinished(InResult);
+
+	if (!InLoad.Batch)
+		return;
+	const int Finished = ++InLoad.Batch->Finished;
+	if (InLoad.Batch->Progress)
+		InLoad.Batch->Progress(Finished, InLoad.Batch->Total);
+}
+
+int CUdSDKComposite::Remove(uint32 InUniqueID)
+{
+	FScopeLock ScopeLock(&DataMutex);
+	enum udError error = udE_Success;
+	AssetsMap.Remove(InUniqueID);
+
+	// a render may still be drawing it from its snapshot, FUdModelRef unloads it once that is gone too
+	int32 Index = INDEX_NONE;
+	if (InstanceIndices.RemoveAndCopyValue(InUniqueID, Index))
+	{
+		RemoveInstanceAt(Index);
 	}
 	return error;
 }
 
+void CUdSDKComposite::RemoveInstanceAt(int32 InIndex)
+{
+	// swap-remove keeps the table dense, only the instance moved into the hole needs its index fixed
+	FUdInstanceBVH& BVH = GetMutableInstanceBVH();
+	BVH.DestroyProxy(InstanceProxies[InIndex]);
+	const int32 LastIndex = InstanceArray.Num() - 1;
+	if (InIndex != LastIndex)
+	{
+		InstanceIndices[InstanceIds[LastIndex]] = InIndex;
+		BVH.SetPayload(InstanceProxies[LastIndex], InIndex);
+	}
+	InstanceArray.RemoveAtSwap(InIndex);
+	InstanceModels.RemoveAtSwap(InIndex);
+	InstanceStates.RemoveAtSwap(InIndex);
+	InstanceIds.RemoveAtSwap(InIndex);
+	InstanceProxies.RemoveAtSwap(InIndex);
+	++InstanceGeneration;
+}
+
+void CUdSDKComposite::ResetInstances()
+{
+	// DataMutex is held by the caller
+	InstanceArray.Reset();
+	InstanceModels.Reset();
+	InstanceStates.Reset();
+	InstanceIndices.Reset();
+	InstanceIds.Reset();
+	InstanceProxies.Reset();
+	InstanceBVH.reset();
+	bInstanceBVHShared = false;
+	++InstanceGeneration;
+}
+
+FUdInstanceBVH& CUdSDKComposite::GetMutableInstanceBVH()
+{
+	// DataMutex is held by the caller. Once per generation, the snapshots keep reading the tree they took
+	if (!InstanceBVH)
+	{
+		InstanceBVH = std::make_shared<FUdInstanceBVH>();
+	}
+	else if (bInstanceBVHShared)
+	{
+		InstanceBVH = std::make_shared<FUdInstanceBVH>(*InstanceBVH);
+	}
+	bInstanceBVHShared = false;
+	return *InstanceBVH;
+}
+
+FBox CUdSDKComposite::GetInstanceWorldBox(int32 InIndex) const
+{
+	const FUdInstanceState& State = InstanceStates[InIndex];
+	return UdInstanceWorldBox(InstanceArray[InIndex].matrix, State.LocalCenter, State.LocalExtent);
+}
+
 int CUdSDKComposite::AsyncRemove(uint32 InUniqueID, const FunCP0& InFunc)
 {
 	enum udError error = udE_Failure;
@@ -541,9 +1022,12 @@ int CUdSDKComposite::AsyncRemove(uint32 InUniqueID, const FunCP0& InFunc)
 		return error;
 	}
 
+	// cancelled right away so a queued load of this actor does not start in the meantime
+	CancelLoad(InUniqueID);
+
 	uint32 UniqueID = InUniqueID;
 	const FunCP0 & Func = InFunc;
-	CThreadPool::Get()->enqueue([UniqueID, Func, this] {
+	ActorExecutor.submit(UniqueID, [UniqueID, Func, this] {
 		Remove(UniqueID);
 		if (Func)
 			Func();
@@ -574,7 +1058,7 @@ int CUdSDKComposite::AsyncFind(uint32 InUniqueID, const FunCP1& InFunc)
 
 	uint32 UniqueID = InUniqueID;
 	const FunCP1& Func = InFunc;
-	CThreadPool::Get()->enqueue([UniqueID, Func, this] {
+	ActorExecutor.submit(UniqueID, [UniqueID, Func, this] {
 		bool bFind = Find(UniqueID);
 		if (Func)Func(bFind);
 	});
@@ -582,6 +1066,57 @@ int CUdSDKComposite::AsyncFind(uint32 InUniqueID, const FunCP1& InFunc)
 	return udE_Success;
 }
 
+#if UDSDK_WITH_COROUTINES
+static void ResumeOnGameThread(std::coroutine_handle<> InHandle)
+{
+	AsyncTask(ENamedThreads::GameThread, [InHandle] { InHandle.resume(); });
+}
+
+static FunResume MakeResume(EUdResumeThread InResumeOn)
+{
+	return InResumeOn == EUdResumeThread::GameThread ? &ResumeOnGameThread : nullptr;
+}
+
+CCallbackAwaitable<int> CUdSDKComposite::LoadAsync(uint32 InUniqueID, TSharedPtr<FUdAsset> InAsset, EUdResumeThread InResumeOn)
+{
+	return CCallbackAwaitable<int>([this, InUniqueID, InAsset](CCallbackAwaitable<int>::FunDone InDone) {
+		FUdLoadRequest Request;
+		Request.UniqueID = InUniqueID;
+		Request.Asset = InAsset;
+		Request.OnFinished = InDone;
+
+		TArray<FUdLoadRequest> Requests;
+		Requests.Add(MoveTemp(Request));
+		if (LoadBatch(Requests) != udE_Success || !InAsset.IsValid())
+			InDone(udE_Failure);
+	}, MakeResume(InResumeOn));
+}
+
+CCallbackAwaitable<int> CUdSDKComposite::RemoveAsync(uint32 InUniqueID, EUdResumeThread InResumeOn)
+{
+	return CCallbackAwaitable<int>([this, InUniqueID](CCallbackAwaitable<int>::FunDone InDone) {
+		if (!LoginFlag)
+		{
+			InDone(udE_Failure);
+			return;
+		}
+
+		CancelLoad(InUniqueID);
+		ActorExecutor.submit(InUniqueID, [this, InUniqueID, InDone] {
+			InDone(Remove(InUniqueID));
+		});
+	}, MakeResume(InResumeOn));
+}
+
+CCallbackAwaitable<bool> CUdSDKComposite::FindAsync(uint32 InUniqueID, EUdResumeThread InResumeOn)
+{
+	return CCallbackAwaitable<bool>([this, InUniqueID](CCallbackAwaitable<bool>::FunDone InDone) {
+		if (AsyncFind(InUniqueID, InDone) != udE_Success)
+			InDone(false);
+	}, MakeResume(InResumeOn));
+}
+#endif
+
 int CUdSDKComposite::AsyncSetTransform(uint32 InUniqueID, const FTransform& InTransform)
 {
 	enum udError error = udE_Failure;
@@ -592,74 +1127,88 @@ int CUdSDKComposite::AsyncSetTransform(uint32 InUniqueID, const FTransform& InTr
 		return error;
 	}
 
-	uint32 UniqueID = InUniqueID;
-	const FTransform& Transform = InTransform;
-	CThreadPool::Get()->enqueue([UniqueID, Transform, this] {
-		SetTransform(UniqueID, Transform);
-	});
+	// no task and no lock per move, drags and sequencer playback only add a queue node here
+	PendingTransforms.Enqueue(TPair<uint32, FTransform>(InUniqueID, InTransform));
 
 	return udE_Success;
 }
 
+void CUdSDKComposite::ApplyPendingTransforms()
+{
+	if (PendingTransforms.IsEmpty())
+		return;
+
+	// last write wins, an actor dragged through many positions this frame is only transformed once
+	TPair<uint32, FTransform> Move;
+	while (PendingTransforms.Dequeue(Move))
+	{
+		CoalescedTransforms.Add(Move.Key, Move.Value);
+	}
+
+	{
+		FScopeLock ScopeLock(&DataMutex);
+		// the whole batch edits one tree, copied at most once from the last snapshot's
+		FUdInstanceBVH& BVH = GetMutableInstanceBVH();
+		for (const auto& Pair : CoalescedTransforms)
+		{
+			UpdateInstanceTransform(Pair.Key, Pair.Value, BVH);
+		}
+	}
+	CoalescedTransforms.Reset();
+}
+
 //PRAGMA_DISABLE_OPTIMIZATION
 int CUdSDKComposite::SetTransform(uint32 InUniqueID, const FTransform& InTransform)
 {
 	FScopeLock ScopeLock(&DataMutex);
-	enum udError error = udE_Success;
-	void* pPointCloud = nullptr;
-	if (TSharedPtr<FUdAsset> Asset = AssetsMap.FindRef(InUniqueID))
+	UpdateInstanceTransform(InUniqueID, InTransform, GetMutableInstanceBVH());
+	return udE_Success;
+}
+
+void CUdSDKComposite::UpdateInstanceTransform(uint32 InUniqueID, const FTransform& InTransform, FUdInstanceBVH& InBVH)
+{
+	// DataMutex is held by the caller
+	const int32* Index = InstanceIndices.Find(InUniqueID);
+	TSharedPtr<FUdAsset> Asset = AssetsMap.FindRef(InUniqueID);
+	if (Index && Asset)
 	{
-		if (Asset->pPointCloud)
-		{
-			pPointCloud = Asset->pPointCloud;
-		}
-		if (pPointCloud)
-		{
-			for (auto& inst : InstanceArray)
-			{
-				if (inst.pPointCloud == pPointCloud)
-				{
-					FTransform t;
-					t.SetLocation(InTransform.GetLocation());
-					t.SetScale3D(InTransform.GetScale3D() * Asset->scale_xyz);
-					t.SetRotation(InTransform.GetRotation());
-					FuncMat2Array(inst.matrix, t.ToMatrixWithScale());
-
-
-					//UDSDK_SCREENDE_DEBUG_MSG("SetTransform::Location : %d : %s", InUniqueID, *InTransform.GetLocation().ToString());
-					//inst.matrix[12] = InTransform.GetLocation().X;
-					//inst.matrix[13] = InTransform.GetLocation().Y;
-					//inst.matrix[14] = InTransform.GetLocation().Z;
-
-					//udDouble3 ud_position;
-					//udDouble3 ud_scale;
-					//udDouble4x4 storedMatrix;
-					//udDouble3 pivot = udDouble3::create(Asset->pivot.X, Asset->pivot.Y, Asset->pivot.Z);
-					//if (1)
-					//{
-					//	ud_position = udDouble3::create(InTransform.GetLocation().X, InTransform.GetLocation().Y, InTransform.GetLocation().Z);
-					//
-					//	ud_scale = udDouble3::create(InTransform.GetScale3D().X * Asset->scale_xyz.X,
-					//		InTransform.GetScale3D().Y * Asset->scale_xyz.Y, 
-					//		InTransform.GetScale3D().Z * Asset->scale_xyz.Z);
-					//
-					//	FVector Euler = InTransform.GetRotation().Euler();
-					//	udDouble3 euler = udDouble3::create(Euler.X, Euler.Y, Euler.Z);
-					//	storedMatrix = udDouble4x4::translation(pivot) *
-					//		udDouble4x4::rotationYPR(UD_DEG2RAD(euler), ud_position) *
-					//		udDouble4x4::scaleNonUniform(ud_scale) *
-					//		udDouble4x4::translation(-pivot);
-					//	memcpy(inst.matrix, storedMatrix.a, sizeof(double) * 16);
-					//}
-
-
-					break;
-				}
-			}
-		}
+		udRenderInstance& inst = InstanceArray[*Index];
+
+		FTransform t;
+		t.SetLocation(InTransform.GetLocation());
+		t.SetScale3D(InTransform.GetScale3D() * Asset->scale_xyz);
+		t.SetRotation(InTransform.GetRotation());
+		FuncMat2Array(inst.matrix, t.ToMatrixWithScale());
+		InBVH.MoveProxy(InstanceProxies[*Index], GetInstanceWorldBox(*Index));
+		++InstanceGeneration;
+
+
+		//UDSDK_SCREENDE_DEBUG_MSG("SetTransform::Location : %d : %s", InUniqueID, *InTransform.GetLocation().ToString());
+		//inst.matrix[12] = InTransform.GetLocation().X;
+		//inst.matrix[13] = InTransform.GetLocation().Y;
+		//inst.matrix[14] = InTransform.GetLocation().Z;
+
+		//udDouble3 ud_position;
+		//udDouble3 ud_scale;
+		//udDouble4x4 storedMatrix;
+		//udDouble3 pivot = udDouble3::create(Asset->pivot.X, Asset->pivot.Y, Asset->pivot.Z);
+		//if (1)
+		//{
+		//	ud_position = udDouble3::create(InTransform.GetLocation().X, InTransform.GetLocation().Y, InTransform.GetLocation().Z);
+		//
+		//	ud_scale = udDouble3::create(InTransform.GetScale3D().X * Asset->scale_xyz.X,
+		//		InTransform.GetScale3D().Y * Asset->scale_xyz.Y, 
+		//		InTransform.GetScale3D().Z * Asset->scale_xyz.Z);
+		//
+		//	FVector Euler = InTransform.GetRotation().Euler();
+		//	udDouble3 euler = udDouble3::create(Euler.X, Euler.Y, Euler.Z);
+		//	storedMatrix = udDouble4x4::translation(pivot) *
+		//		udDouble4x4::rotationYPR(UD_DEG2RAD(euler), ud_position) *
+		//		udDouble4x4::scaleNonUniform(ud_scale) *
+		//		udDouble4x4::translation(-pivot);
+		//	memcpy(inst.matrix, storedMatrix.a, sizeof(double) * 16);
+		//}
 	}
-	
-	return error;
 }
 //PRAGMA_ENABLE_OPTIMIZATION
 
@@ -675,7 +1224,7 @@ int CUdSDKComposite::AsyncSetSelected(uint32 InUniqueID, bool InSelect)
 
 	uint32 UniqueID = InUniqueID;
 	const bool& Select = InSelect;
-	CThreadPool::Get()->enqueue([UniqueID, Select, this] {
+	ActorExecutor.submit(UniqueID, [UniqueID, Select, this] {
 		SetSelected(UniqueID, Select);
 	});
 
@@ -689,82 +1238,978 @@ int CUdSDKComposite::SetSelected(uint32 InUniqueID, bool InSelect)
 	void* pPointCloud = nullptr;
 	if (TSharedPtr<FUdAsset> Asset = AssetsMap.FindRef(InUniqueID))
 	{
+		if (Asset->selected != InSelect)
+			++SelectionGeneration;
 		Asset->selected = InSelect;
 	}
 	return error;
 }
 
-int CUdSDKComposite::SetSelectedByModelIndex(uint32 InModelIndex, bool InSelect)
+int CUdSDKComposite::SetSelectedByModelIndex(const FUdViewState& InViewState, uint32 InModelIndex, bool InSelect)
 {
-	FScopeLock ScopeLock(&DataMutex);
-	enum udError error = udE_Success;
-
-	if (InModelIndex < (uint32)InstanceArray.Num())
-	{
-		udRenderInstance& tmpIns = InstanceArray[InModelIndex];
-		FUdAsset* pAsset = static_cast<FUdAsset*>(tmpIns.pVoxelUserData);
-		if (pAsset)
-		{
-			pAsset->selected = InSelect;
-		}
-	}
+	uint32 UniqueID = 0;
+	if (!ResolvePickedModel(InViewState, InModelIndex, UniqueID))
+		return udE_NotFound;
 
-	return error;
+	return SetSelected(UniqueID, InSelect);
 }
-//PRAGMA_DISABLE_OPTIMIZATION
-int CUdSDKComposite::CaptureUDSImage(const FSceneView& View)
+
+bool CUdSDKComposite::ResolvePickedModel(const FUdViewState& InViewState, uint32 InModelIndex, uint32& OutUniqueID)
 {
-	//FScopeLock ScopeLockCall(&CallMutex);
+	// the snapshot and the culled list stay as that render saw them until the next capture of the view
+	if (!InViewState.Snapshot || !InViewState.VisibleToSnapshot.IsValidIndex((int32)InModelIndex))
+		return false;
+
+	const int32 Index = InViewState.VisibleToSnapshot[InModelIndex];
+	if (!InViewState.Snapshot->UniqueIds.IsValidIndex(Index))
+		return false;
+
+	OutUniqueID = InViewState.Snapshot->UniqueIds[Index];
+	return true;
+}
 
+int CUdSDKComposite::AsyncSetMaxDrawDistance(uint32 InUniqueID, float InDistance)
+{
 	enum udError error = udE_Failure;
 
 	if (!LoginFlag)
 	{
-		//UDSDK_ERROR_MSG("Not logged in!");
+		UDSDK_ERROR_MSG("AsyncSetMaxDrawDistance -> Not logged in!");
 		return error;
 	}
 
+	uint32 UniqueID = InUniqueID;
+	ActorExecutor.submit(UniqueID, [UniqueID, InDistance, this] {
+		SetMaxDrawDistance(UniqueID, InDistance);
+	});
+
+	return udE_Success;
+}
+
+int CUdSDKComposite::SetMaxDrawDistance(uint32 InUniqueID, float InDistance)
+{
+	FScopeLock ScopeLock(&DataMutex);
+	if (TSharedPtr<FUdAsset> Asset = AssetsMap.FindRef(InUniqueID))
 	{
-		FScopeLock ScopeLock(&DataMutex);
-		if (InstanceArray.Num() == 0)
-			return error;
+		Asset->max_draw_distance = InDistance;
+		// the snapshot carries the squared distance per instance
+		++InstanceGeneration;
+		return udE_Success;
 	}
-	
-
+	return udE_NotFound;
+}
 
-	uint32 nWidth = View.UnconstrainedViewRect.Width();
-	uint32 nHeight = View.UnconstrainedViewRect.Height();
-	if (nWidth == 0 || nHeight == 0)
-		return error;
+int CUdSDKComposite::QueryRay(const FVector& InOrigin, const FVector& InDirection, float InMaxDistance, TArray<uint32>& OutUniqueIDs)
+{
+	ApplyPendingTransforms();
+	SCOPE_CYCLE_COUNTER(STAT_UdsInstanceQueries);
 
-	error = (udError)RecreateUDView(nWidth, nHeight, View.FOV);
+	FScopeLock ScopeLock(&DataMutex);
+	OutUniqueIDs.Reset();
+	if (!InstanceBVH)
+		return udE_Success;
+
+	TArray<TPair<float, int32>> Hits;
+	InstanceBVH->QueryRay(InOrigin, InDirection, InMaxDistance, Hits);
+	TArray<int32> Slots;
+	Slots.Reserve(Hits.Num());
+	for (const TPair<float, int32>& Hit : Hits)
+	{
+		Slots.Add(Hit.Value);
+	}
+	GatherVisibleIds(Slots, OutUniqueIDs);
+	return udE_Success;
+}
+
+int CUdSDKComposite::QueryBox(const FBox& InBox, TArray<uint32>& OutUniqueIDs)
+{
+	ApplyPendingTransforms();
+	SCOPE_CYCLE_COUNTER(STAT_UdsInstanceQueries);
+
+	FScopeLock ScopeLock(&DataMutex);
+	OutUniqueIDs.Reset();
+	if (!InstanceBVH)
+		return udE_Success;
+
+	TArray<int32> Slots;
+	InstanceBVH->QueryBox(InBox, Slots);
+	GatherVisibleIds(Slots, OutUniqueIDs);
+	return udE_Success;
+}
+
+int CUdSDKComposite::QuerySphere(const FSphere& InSphere, TArray<uint32>& OutUniqueIDs)
+{
+	ApplyPendingTransforms();
+	SCOPE_CYCLE_COUNTER(STAT_UdsInstanceQueries);
+
+	FScopeLock ScopeLock(&DataMutex);
+	OutUniqueIDs.Reset();
+	if (!InstanceBVH)
+		return udE_Success;
+
+	TArray<int32> Slots;
+	InstanceBVH->QuerySphere(InSphere, Slots);
+	GatherVisibleIds(Slots, OutUniqueIDs);
+	return udE_Success;
+}
+
+void CUdSDKComposite::GatherVisibleIds(const TArray<int32>& InSlots, TArray<uint32>& OutUniqueIDs) const
+{
+	// DataMutex is held by the caller
+	OutUniqueIDs.Reserve(InSlots.Num());
+	for (const int32 Slot : InSlots)
+	{
+		if (InstanceStates[Slot].bVisible)
+			OutUniqueIDs.Add(InstanceIds[Slot]);
+	}
+}
+
+int CUdSDKComposite::AsyncSetVisible(uint32 InUniqueID, bool InVisible)
+{
+	enum udError error = udE_Failure;
+
+	if (!LoginFlag)
+	{
+		UDSDK_ERROR_MSG("AsyncSetVisible -> Not logged in!");
+		return error;
+	}
+
+	uint32 UniqueID = InUniqueID;
+	ActorExecutor.submit(UniqueID, [UniqueID, InVisible, this] {
+		SetVisible(UniqueID, InVisible);
+	});
+
+	return udE_Success;
+}
+
+int CUdSDKComposite::SetVisible(uint32 InUniqueID, bool InVisible)
+{
+	TSharedPtr<FUdAsset> Asset;
+	{
+		FScopeLock ScopeLock(&DataMutex);
+		const int32* Index = InstanceIndices.Find(InUniqueID);
+		if (!Index)
+			return udE_NotFound;
+
+		FUdInstanceState& State = InstanceStates[*Index];
+		if (State.bVisible != InVisible)
+		{
+			State.bVisible = InVisible;
+			State.HiddenSince = InVisible ? 0.0 : FPlatformTime::Seconds();
+			++InstanceGeneration;
+		}
+		if (!InVisible || InstanceModels[*Index])
+			return udE_Success;
+		Asset = AssetsMap.FindRef(InUniqueID);
+		if (!Asset.IsValid())
+			return udE_NotFound;
+	}
+
+	// evicted while hidden: the model comes back through the load queue, nearest first and
+	// within r.Uds.MaxConcurrentLoads, so showing many instances at once does not flood udSDK
+	{
+		FScopeLock ScopeLock(&LoadMutex);
+		if (LoadTokens.Contains(InUniqueID))
+			return udE_Success;
+
+		FUdPendingLoad Load;
+		Load.Request.UniqueID = InUniqueID;
+		Load.Request.Asset = Asset;
+		Load.bRestoreModel = true;
+		// stays empty, there is no token for InUniqueID to supersede
+		TArray<FUdPendingLoad> SupersededLoads;
+		PushPendingLoad(MoveTemp(Load), SupersededLoads);
+	}
+	PumpLoads();
+	return udE_Success;
+}
+
+int CUdSDKComposite::RestoreEvictedModel(uint32 InUniqueID)
+{
+	TSharedPtr<FUdAsset> Asset;
+	{
+		FScopeLock ScopeLock(&DataMutex);
+		const int32* Index = InstanceIndices.Find(InUniqueID);
+		if (!Index)
+			return udE_NotFound;
+		// hidden again while queued, or restored meanwhile
+		if (!InstanceStates[*Index].bVisible || InstanceModels[*Index])
+			return udE_NothingToDo;
+		Asset = AssetsMap.FindRef(InUniqueID);
+		if (!Asset.IsValid())
+			return udE_NotFound;
+	}
+
+	// the instance kept its matrix and selection, only the model has to come back
+	FUdModelPtr Model;
+	enum udError error = (udError)AcquireModel(Asset->url, Model);
+	if (error != udE_Success)
+		return error;
+
+	FScopeLock ScopeLock(&DataMutex);
+	const int32* Index = InstanceIndices.Find(InUniqueID);
+	if (Index && !InstanceModels[*Index])
+	{
+		InstanceModels[*Index] = std::make_shared<FUdModelRef>(Model, Asset);
+		InstanceArray[*Index].pPointCloud = Model->pPointCloud;
+		Asset->pPointCloud = Model->pPointCloud;
+		++InstanceGeneration;
+	}
+	return error;
+}
+//PRAGMA_DISABLE_OPTIMIZATION
+uint64 CUdSDKComposite::GetViewKey(const FSceneView& View)
+{
+	// the persistent view state is the most stable identity, it survives resizes and FOV changes
+	if (View.State)
+	{
+		return View.State->GetViewKey();
+	}
+
+	uint64 EditorViewBitflag = 1;
+#if WITH_EDITOR
+	EditorViewBitflag = View.SceneViewInitOptions.EditorViewBitflag;
+#endif
+	return ((uint64)1 << 63) | ((uint64)View.StereoPass << 48) | EditorViewBitflag;
+}
+
+FUdViewStatePtr CUdSDKComposite::FindOrAddViewState(uint64 InViewKey)
+{
+	FUdViewStatePtr& ViewState = ViewStates.FindOrAdd(InViewKey);
+	if (!ViewState.IsValid())
+	{
+		ViewState = MakeShared<FUdViewState, ESPMode::ThreadSafe>();
+		ViewState->ViewKey = InViewKey;
+	}
+	ViewState->LastUsedFrame = GFrameCounter;
+	return ViewState;
+}
+
+void CUdSDKComposite::TrimViewStates()
+{
+	if (LastTrimFrame == GFrameCounter)
+		return;
+	LastTrimFrame = GFrameCounter;
+
+	const uint64 MaxUnusedFrames = (uint64)FMath::Max(1, CVarUdsViewStateTimeout.GetValueOnGameThread());
+	for (auto It = ViewStates.CreateIterator(); It; ++It)
+	{
+		const FUdViewStatePtr& ViewState = It.Value();
+		if (GFrameCounter - ViewState->LastUsedFrame > MaxUnusedFrames && !RenderWorker.busy(ViewState->ViewKey))
+		{
+			DestroyViewState(ViewState);
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void CUdSDKComposite::DestroyViewState(const FUdViewStatePtr& InViewState)
+{
+	RenderWorker.wait(InViewState->ViewKey);
+	ReleaseUploadSlots(InViewState);
+	DestroyTiles(*InViewState);
+
+	if (InViewState->pRenderView)
+	{
+		enum udError error = udRenderTarget_Destroy(&InViewState->pRenderView);
+		if (error != udE_Success)
+		{
+			UDSDK_ERROR_MSG("udRenderTarget_Destroy error : %s", GetError(error));
+		}
+		InViewState->pRenderView = nullptr;
+	}
+
+	// the textures are released by the last render command still holding the state
+	InViewState->Width = 0;
+	InViewState->Height = 0;
+	InViewState->bFrontBufferDirty = false;
+	InViewState->Snapshot.reset();
+}
+
+int CUdSDKComposite::CaptureUDSImage(const FSceneView& View, FTexture2DRHIRef& OutColorTexture, FTexture2DRHIRef& OutDepthTexture, FUdViewStatePtr& OutViewState)
+{
+	//FScopeLock ScopeLockCall(&CallMutex);
+
+	enum udError error = udE_Failure;
+
+	if (!LoginFlag)
+	{
+		//UDSDK_ERROR_MSG("Not logged in!");
+		return error;
+	}
+
+	TrimViewStates();
+
+	// pending loads are prioritized by their distance to the camera
+	{
+		FScopeLock ScopeLock(&LoadMutex);
+		LastViewOrigin = View.ViewMatrices.GetViewOrigin();
+	}
+
+	UpdateStreamingBudget();
+
+	if (GetInstanceSnapshot()->Instances.Num() == 0)
+		return error;
+
+
+
+	// the composite covers View.ViewRect, the UDS image matches it pixel for pixel before any scaling
+	uint32 nWidth = View.ViewRect.Width();
+	uint32 nHeight = View.ViewRect.Height();
+	if (nWidth == 0 || nHeight == 0)
+		return error;
+
+	FUdViewStatePtr ViewState = FindOrAddViewState(GetViewKey(View));
+
+	const float RenderScale = UpdateRenderScale(*ViewState);
+	nWidth = FMath::Max(1u, (uint32)FMath::CeilToInt(nWidth * RenderScale));
+	nHeight = FMath::Max(1u, (uint32)FMath::CeilToInt(nHeight * RenderScale));
+
+	error = (udError)CaptureViewState(ViewState, View, nWidth, nHeight);
+
+	OutColorTexture = ViewState->ColorTexture;
+	OutDepthTexture = ViewState->DepthTexture;
+	OutViewState = ViewState;
+	return error;
+}
+
+FUdInstanceSnapshotPtr CUdSDKComposite::GetInstanceSnapshot()
+{
+	ApplyPendingTransforms();
+
+	// game thread only; without edits since the last call this is a single atomic load
+	const uint64 Generation = InstanceGeneration;
+	if (PublishedSnapshot && PublishedSnapshot->Generation == Generation)
+	{
+		return PublishedSnapshot;
+	}
+
+	FVector ViewOrigin;
+	{
+		FScopeLock ScopeLock(&LoadMutex);
+		ViewOrigin = LastViewOrigin;
+	}
+
+	std::shared_ptr<FUdInstanceSnapshot> Snapshot = std::make_shared<FUdInstanceSnapshot>();
+	{
+		FScopeLock ScopeLock(&DataMutex);
+		Snapshot->Generation = InstanceGeneration;
+
+		// hidden instances stay in the table, and keep their model unless it was evicted, but are not rendered
+		TArray<int32> Order;
+		Order.Reserve(InstanceArray.Num());
+		for (int32 i = 0; i < InstanceArray.Num(); i++)
+		{
+			if (InstanceStates[i].bVisible && InstanceModels[i])
+				Order.Add(i);
+		}
+		SET_DWORD_STAT(STAT_UdsHiddenInstances, InstanceArray.Num() - Order.Num());
+
+		// over the streaming budget: render only the nearest ones, the nearest instance is never parked
+		const int32 Parked = FMath::Min(BudgetParkedCount, Order.Num() - 1);
+		if (Parked > 0)
+		{
+			auto DistSquared = [this, &ViewOrigin](int32 InIndex) {
+				const double* Matrix = InstanceArray[InIndex].matrix;
+				return FVector::DistSquared(FVector((float)Matrix[12], (float)Matrix[13], (float)Matrix[14]), ViewOrigin);
+			};
+			Order.Sort([&DistSquared](int32 A, int32 B) { return DistSquared(A) < DistSquared(B); });
+		}
+
+		const int32 Kept = Order.Num() - FMath::Max(Parked, 0);
+		Snapshot->Instances.Reserve(Kept);
+		Snapshot->Models.Reserve(Kept);
+		Snapshot->UniqueIds.Reserve(Kept);
+		Snapshot->SlotToInstance.Init(INDEX_NONE, InstanceArray.Num());
+		for (int32 i = 0; i < Kept; i++)
+		{
+			const int32 Index = Order[i];
+			Snapshot->SlotToInstance[Index] = i;
+			const FUdModelRefPtr& ModelRef = InstanceModels[Index];
+			Snapshot->Instances.Add(InstanceArray[Index]);
+			Snapshot->Models.Add(ModelRef);
+			Snapshot->UniqueIds.Add(InstanceIds[Index]);
+			// the views cull against these, so a moved instance is culled where it is now
+			UdAddInstanceBounds(Snapshot->Bounds, InstanceArray[Index].matrix, ModelRef->Model->Header, ModelRef->Asset->max_draw_distance);
+		}
+		UdFinishInstanceBounds(Snapshot->Bounds);
+
+		// shared until the next edit copies it, the views query it without DataMutex
+		Snapshot->BVH = InstanceBVH;
+		bInstanceBVHShared = InstanceBVH != nullptr;
+		SET_DWORD_STAT(STAT_UdsBVHHeight, InstanceBVH ? InstanceBVH->GetHeight() : 0);
+	}
+	PublishedSnapshot = Snapshot;
+	return PublishedSnapshot;
+}
+
+void CUdSDKComposite::UpdateStreamer()
+{
+	if (!bManualStreamerUpdate)
+		return;
+
+	udStreamerInfo Info;
+	memset(&Info, 0, sizeof(udStreamerInfo));
+
+	enum udError error = udE_Failure;
+	{
+		// udSDK expects the update between renders, not during one
+		FScopeLock ScopeLockRender(&RenderMutex);
+		error = udStreamer_Update(&Info);
+	}
+	if (error != udE_Success)
+	{
+		UDSDK_ERROR_MSG("udStreamer_Update error : %s", GetError(error));
+		return;
+	}
+
+	// blocks loaded or dropped since the renders before this update, they no longer show what a new render would
+	if (Info.active || Info.memoryInUse != StreamerMemoryInUse)
+		++StreamerChangeCount;
+	StreamerMemoryInUse = Info.memoryInUse;
+	StreamerStarvedMs = Info.starvedTimeMsSinceLastUpdate;
+	StreamerModelsActive = Info.modelsActive;
+	++StreamerUpdateCount;
+}
+
+void CUdSDKComposite::UpdateStreamingBudget()
+{
+	bManualStreamerUpdate = CVarUdsStreamerManualUpdate.GetValueOnGameThread() > 0;
+
+	SET_FLOAT_STAT(STAT_UdsStreamerMemoryMB, StreamerMemoryInUse / (1024.0f * 1024.0f));
+	SET_DWORD_STAT(STAT_UdsStreamerStarvedMs, StreamerStarvedMs);
+	SET_DWORD_STAT(STAT_UdsStreamerModelsActive, StreamerModelsActive);
+	SET_DWORD_STAT(STAT_UdsBudgetParkedInstances, BudgetParkedCount);
+
+	// only act on a fresh sample, and no faster than the streamer can follow
+	const uint32 UpdateCount = StreamerUpdateCount;
+	const double Now = FPlatformTime::Seconds();
+	if (UpdateCount == LastBudgetUpdateCount || Now - LastBudgetStepTime < BudgetStepSeconds)
+		return;
+	LastBudgetUpdateCount = UpdateCount;
+	LastBudgetStepTime = Now;
+
+	const int64 Budget = (int64)CVarUdsStreamerMemoryBudgetMB.GetValueOnGameThread() * 1024 * 1024;
+	const int64 MemoryInUse = StreamerMemoryInUse;
+	int32 Parked = BudgetParkedCount;
+	if (Budget > 0 && bManualStreamerUpdate && MemoryInUse > Budget)
+	{
+		// what is not on screen goes before what is
+		if (!EvictHiddenModel(Now))
+		{
+			FScopeLock ScopeLock(&DataMutex);
+			Parked = FMath::Min(Parked + 1, FMath::Max(0, InstanceArray.Num() - 1));
+		}
+	}
+	else if (Budget <= 0 || !bManualStreamerUpdate || MemoryInUse < Budget * BudgetResumeFraction)
+	{
+		Parked = FMath::Max(Parked - 1, 0);
+	}
+
+	// while anything is parked the snapshot is rebuilt every step so the choice follows the camera
+	if (Parked > 0 || Parked != BudgetParkedCount)
+	{
+		BudgetParkedCount = Parked;
+		++InstanceGeneration;
+	}
+}
+
+bool CUdSDKComposite::EvictHiddenModel(double InNow)
+{
+	const double MinHiddenSeconds = FMath::Max(0.0f, CVarUdsHiddenEvictSeconds.GetValueOnGameThread());
+
+	FScopeLock ScopeLock(&DataMutex);
+
+	// a model is shared by every instance of its url and only unloads once all of them let go,
+	// so it is evicted as a whole once every instance holding it has been hidden long enough
+	struct FEvictCandidate
+	{
+		int32 Holders = 0;
+		int32 FirstIndex = INDEX_NONE;
+		//When the last of its holders was hidden
+		double HiddenSince = 0.0;
+	};
+	TMap<const FUdModel*, FEvictCandidate> Candidates;
+	for (int32 i = 0; i < InstanceArray.Num(); i++)
+	{
+		const FUdInstanceState& State = InstanceStates[i];
+		if (State.bVisible || !InstanceModels[i])
+			continue;
+		FEvictCandidate& Candidate = Candidates.FindOrAdd(InstanceModels[i]->Model.get());
+		if (Candidate.Holders++ == 0)
+			Candidate.FirstIndex = i;
+		Candidate.HiddenSince = FMath::Max(Candidate.HiddenSince, State.HiddenSince);
+	}
+
+	const FUdModel* Oldest = nullptr;
+	double OldestHiddenSince = 0.0;
+	for (const auto& Pair : Candidates)
+	{
+		const FEvictCandidate& Candidate = Pair.Value;
+		// a visible instance, or a load in flight, still holds the model
+		if (InstanceModels[Candidate.FirstIndex]->Model.use_count() != Candidate.Holders || InNow - Candidate.HiddenSince < MinHiddenSeconds)
+			continue;
+		if (!Oldest || Candidate.HiddenSince < OldestHiddenSince)
+		{
+			Oldest = Pair.Key;
+			OldestHiddenSince = Candidate.HiddenSince;
+		}
+	}
+	if (!Oldest)
+		return false;
+
+	// the model cache unloads the point cloud once the snapshots still holding it are gone
+	for (int32 i = 0; i < InstanceArray.Num(); i++)
+	{
+		if (!InstanceModels[i] || InstanceModels[i]->Model.get() != Oldest)
+			continue;
+		InstanceModels[i].reset();
+		InstanceArray[i].pPointCloud = nullptr;
+		if (TSharedPtr<FUdAsset> Asset = AssetsMap.FindRef(InstanceIds[i]))
+		{
+			Asset->pPointCloud = nullptr;
+		}
+		INC_DWORD_STAT(STAT_UdsHiddenModelsEvicted);
+	}
+	++InstanceGeneration;
+	return true;
+}
+
+void CUdSDKComposite::CullInstances(FUdViewState& InViewState, const FMatrix& InViewProjection, bool InHasFarPlane, const FVector& InViewOrigin)
+{
+	const FUdInstanceSnapshot& Snapshot = *InViewState.Snapshot;
+	TArray<int32>& VisibleToSnapshot = InViewState.VisibleToSnapshot;
+	if (CVarUdsCulling.GetValueOnGameThread() > 0)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsCullInstances);
+		FVector4 Planes[6];
+		const int32 PlaneCount = UdBuildFrustumPlanes(InViewProjection, InHasFarPlane, Planes);
+		const int32 BVHMinInstances = CVarUdsCullingBVHMinInstances.GetValueOnGameThread();
+		if (Snapshot.BVH && BVHMinInstances > 0 && Snapshot.Instances.Num() >= BVHMinInstances)
+		{
+			// the tree also holds the hidden and parked instances, and knows nothing of draw distances
+			TArray<int32> Slots;
+			Snapshot.BVH->QueryFrustum(Planes, PlaneCount, Slots);
+			VisibleToSnapshot.Reset(Slots.Num());
+			for (const int32 Slot : Slots)
+			{
+				const int32 Index = Snapshot.SlotToInstance[Slot];
+				if (Index != INDEX_NONE && UdIsInstanceVisible(Snapshot.Bounds, Index, Planes, PlaneCount, InViewOrigin))
+					VisibleToSnapshot.Add(Index);
+			}
+			// same order as the flat path, so the render list does not reshuffle between frames
+			VisibleToSnapshot.Sort();
+		}
+		else
+		{
+			UdCullInstances(Snapshot.Bounds, Planes, PlaneCount, InViewOrigin, VisibleToSnapshot);
+		}
+	}
+	else
+	{
+		VisibleToSnapshot.SetNumUninitialized(Snapshot.Instances.Num());
+		for (int32 i = 0; i < VisibleToSnapshot.Num(); i++)
+		{
+			VisibleToSnapshot[i] = i;
+		}
+	}
+
+	// udRenderContext_Render wants the instances side by side
+	InViewState.VisibleInstances.Reset(VisibleToSnapshot.Num());
+	for (const int32 Index : VisibleToSnapshot)
+	{
+		InViewState.VisibleInstances.Add(Snapshot.Instances[Index]);
+	}
+	INC_DWORD_STAT_BY(STAT_UdsCulledInstances, Snapshot.Instances.Num() - VisibleToSnapshot.Num());
+}
+
+udRenderContextFlags CUdSDKComposite::GetRenderFlags(const FUdViewState& InViewState) const
+{
+	uint32 Flags = udRCF_None;
+	if (bManualStreamerUpdate)
+		Flags |= udRCF_ManualStreamerUpdate;
+	if (InViewState.PendingFrame.LogDepthScale > 0.0f)
+		Flags |= udRCF_LogarithmicDepth;
+	return (udRenderContextFlags)Flags;
+}
+
+FMatrix CUdSDKComposite::BuildProjectionMatrix(float InFOV, uint32 InWidth, uint32 InHeight, float InFarZ)
+{
+	// forward Z: udSDK writes this projection's device Z, infinite unless a far plane is given
+	const float MinZ = GNearClippingPlane;
+	const float MaxZ = InFarZ > MinZ ? InFarZ : MinZ;
+	const float ModifiedViewFOV = InFOV;
+	const float MatrixFOV = FMath::Max(0.001f, ModifiedViewFOV) * (float)PI / 360.0f;
+
+	float const XAxisMultiplier = 1.0f;
+	float const YAxisMultiplier = InWidth / (float)InHeight;
+
+	return FPerspectiveMatrix(
+		MatrixFOV,
+		MatrixFOV,
+		XAxisMultiplier,
+		YAxisMultiplier,
+		MinZ,
+		MaxZ
+	);
+}
+
+float CUdSDKComposite::UpdateRenderScale(FUdViewState& InViewState)
+{
+	static const float ScaleStep = 1.0f / 16.0f;
+
+	const float MinScale = FMath::Clamp(CVarUdsResolutionScaleMin.GetValueOnGameThread(), 0.25f, 1.0f);
+	const float TargetMs = CVarUdsResolutionScaleTargetMs.GetValueOnGameThread();
+
+	float Scale = FMath::Clamp(CVarUdsResolutionScale.GetValueOnGameThread(), 0.25f, 1.0f);
+	if (TargetMs > 0.0f)
+	{
+		// raster cost follows the pixel count, so step the scale by the square root of the time ratio
+		const float LastMs = InViewState.LastRenderTimeMs;
+		if (LastMs > 0.0f)
+		{
+			const float Ratio = FMath::Clamp(FMath::Sqrt(TargetMs / LastMs), 0.9f, 1.05f);
+			InViewState.AutoRenderScale = FMath::Clamp(InViewState.AutoRenderScale * Ratio, MinScale, 1.0f);
+		}
+		Scale = InViewState.AutoRenderScale;
+	}
+
+	// snap so small adjustments do not recreate the render target every frame
+	return FMath::Clamp(FMath::GridSnap(Scale, ScaleStep), 0.25f, 1.0f);
+}
+
+int CUdSDKComposite::CaptureViewState(const FUdViewStatePtr& InViewState, const FSceneView& View, uint32 InWidth, uint32 InHeight)
+{
+	enum udError error = udE_Failure;
+
+	FUdViewState& ViewState = *InViewState;
+	const bool bAsyncRender = CVarUdsAsyncRender.GetValueOnGameThread() > 0;
+	const bool bZeroCopy = CVarUdsZeroCopyUpload.GetValueOnGameThread() > 0;
+	if (bAsyncRender && RenderWorker.busy(ViewState.ViewKey))
+	{
+		// the worker is still busy with this view's previous frame, keep presenting the last finished one
+		UploadFrontBuffer(InViewState);
+		return udE_Success;
+	}
+
+	const bool bLogDepth = CVarUdsLogarithmicDepth.GetValueOnGameThread() > 0;
+	const float LogDepthFarZ = FMath::Max(CVarUdsLogarithmicDepthFarPlane.GetValueOnGameThread(), GNearClippingPlane * 2.0f);
+
+	// interleaved rendering: each frame covers one phase of a Factor.X x Factor.Y pixel pattern,
+	// the temporal reprojection needs the device Z so it is not available with logarithmic depth
+	FIntPoint TemporalFactor(1, 1);
+	switch (bLogDepth ? 0 : CVarUdsTemporal.GetValueOnGameThread())
+	{
+	case 1: TemporalFactor = FIntPoint(2, 1); break;
+	case 2: TemporalFactor = FIntPoint(2, 2); break;
+	default: break;
+	}
+	const uint32 RenderWidth = FMath::DivideAndRoundUp(InWidth, (uint32)TemporalFactor.X);
+	const uint32 RenderHeight = FMath::DivideAndRoundUp(InHeight, (uint32)TemporalFactor.Y);
+	// reconstruct an exact multiple of the interleaved image, the upscale pass absorbs the odd pixel
+	InWidth = RenderWidth * TemporalFactor.X;
+	InHeight = RenderHeight * TemporalFactor.Y;
+
+	// zero-copy renders straight into the texture, udSDK only writes 32-bit depth
+	const bool bHalfDepth = !bZeroCopy && CVarUdsDepthFormat.GetValueOnGameThread() == 1;
+
+	// the worker is idle for this view from here on, so its render target and matrices can be touched safely
+	const bool bResized = RenderWidth != (uint32)ViewState.Width || RenderHeight != (uint32)ViewState.Height || bZeroCopy != ViewState.bZeroCopyUpload || bHalfDepth != ViewState.bHalfDepth;
+	error = (udError)RecreateUDView(InViewState, RenderWidth, RenderHeight, bZeroCopy, bHalfDepth);
 	if (error != udE_Success)
 	{
 		UDSDK_ERROR_MSG("RecreateUDView error : %s", GetError(error));
 		return error;
 	}
 
-	FuncMat2Array(ProjArray, ProjectionMatrix);
-	FuncMat2Array(ViewArray, View.ViewMatrices.GetViewMatrix());
+	error = (udError)RecreateTiles(ViewState, CVarUdsRenderTiles.GetValueOnGameThread());
+	if (error != udE_Success)
+	{
+		UDSDK_ERROR_MSG("RecreateTiles error : %s", GetError(error));
+		return error;
+	}
 
+	// the projection keeps the aspect of the reconstructed image, not of the interleaved one
+	ViewState.ProjectionMatrix = BuildProjectionMatrix(View.FOV, InWidth, InHeight, bLogDepth ? LogDepthFarZ : 0.0f);
+
+	ViewState.Snapshot = GetInstanceSnapshot();
+
+	FUdFrameInfo& Frame = ViewState.PendingFrame;
+	Frame.FrameNumber = ++ViewState.FrameCounter;
+	Frame.TargetSize = FIntPoint(InWidth, InHeight);
+	Frame.TemporalFactor = TemporalFactor;
+	Frame.TemporalPhase = FIntPoint(Frame.FrameNumber % TemporalFactor.X, (Frame.FrameNumber / TemporalFactor.X) % TemporalFactor.Y);
+	Frame.ViewProjection = View.ViewMatrices.GetViewMatrix() * ViewState.ProjectionMatrix;
+	Frame.InvDeviceZToWorldZTransform = CreateInvDeviceZToWorldZTransform(ViewState.ProjectionMatrix);
+	Frame.LogDepthScale = bLogDepth ? FMath::Log2(LogDepthFarZ + 1.0f) : 0.0f;
+	// half floats are only dense near 0, so the forward device Z (which crowds towards 1) is flipped before packing;
+	// log depth is already spread evenly and is packed as is
+	Frame.bReversedDepth = bHalfDepth && !bLogDepth;
+	if (Frame.bReversedDepth)
 	{
-		FScopeLock ScopeLockData(&BulkDataMutex);
-		FScopeLock ScopeLockInst(&DataMutex);
+		// 1 - DeviceZ of the infinite UDS projection is Near / ViewZ, with Near = -M[3][2]
+		Frame.InvDeviceZToWorldZTransform = FVector4(0.0f, 0.0f, -1.0f / ViewState.ProjectionMatrix.M[3][2], 0.0f);
+	}
+
+	// shift the image so pixel (x, y) of the small target lands on pixel (x * Factor + Phase) of the full one
+	FMatrix JitteredProjection = ViewState.ProjectionMatrix;
+	JitteredProjection.M[2][0] -= (Frame.TemporalPhase.X + 0.5f - 0.5f * TemporalFactor.X) * 2.0f / InWidth;
+	JitteredProjection.M[2][1] += (Frame.TemporalPhase.Y + 0.5f - 0.5f * TemporalFactor.Y) * 2.0f / InHeight;
 
-		error = udRenderTarget_SetTargets(pRenderView, ColorBulkData.GetData(), 0xFF000000, DepthBulkData.GetData());
+	FuncMat2Array(ViewState.ProjArray, JitteredProjection);
+	FuncMat2Array(ViewState.ViewArray, View.ViewMatrices.GetViewMatrix());
+
+	// narrow the frustum to each band: its NDC rows [Center - HalfExtent, Center + HalfExtent] become [-1, 1]
+	for (FUdRenderTile& Tile : ViewState.Tiles)
+	{
+		FMatrix TileProjection = JitteredProjection;
+		const float Center = 1.0f - (2.0f * Tile.Y + Tile.Height) / ViewState.Height;
+		const float HalfExtent = (float)Tile.Height / ViewState.Height;
+		for (int Row = 0; Row < 4; Row++)
+		{
+			TileProjection.M[Row][1] = (TileProjection.M[Row][1] - Center * TileProjection.M[Row][3]) / HalfExtent;
+		}
+		FuncMat2Array(Tile.ProjArray, TileProjection);
+	}
+
+	CullInstances(ViewState, View.ViewMatrices.GetViewMatrix() * JitteredProjection, bLogDepth, View.ViewMatrices.GetViewOrigin());
+
+	// an interleaved frame moves its jitter every frame, so only a still single phase view gets here twice
+	FUdRenderKey RenderKey;
+	FMemory::Memcpy(RenderKey.ViewArray, ViewState.ViewArray, sizeof(RenderKey.ViewArray));
+	FMemory::Memcpy(RenderKey.ProjArray, ViewState.ProjArray, sizeof(RenderKey.ProjArray));
+	RenderKey.InstanceGeneration = ViewState.Snapshot->Generation;
+	RenderKey.SelectionGeneration = SelectionGeneration;
+	RenderKey.SelectColor = GetSelectColor();
+	RenderKey.RenderFlags = GetRenderFlags(ViewState);
+	RenderKey.VisibleHash = FCrc::MemCrc32(ViewState.VisibleToSnapshot.GetData(), ViewState.VisibleToSnapshot.Num() * sizeof(int32));
+	RenderKey.bManualStreamer = bManualStreamerUpdate;
+	RenderKey.StreamerUpdateCount = StreamerUpdateCount;
+	RenderKey.StreamerChangeCount = StreamerChangeCount;
+	RenderKey.bValid = true;
+	if (!bResized && CVarUdsSkipUnchangedFrames.GetValueOnGameThread() > 0 && RenderKey.IsSameImage(ViewState.LastRenderKey))
+	{
+		// the textures already hold this image, nothing is rendered nor uploaded
+		INC_DWORD_STAT(STAT_UdsSkippedFrames);
+		UploadFrontBuffer(InViewState);
+		return udE_Success;
+	}
+	ViewState.LastRenderKey = RenderKey;
+
+	if (ViewState.bZeroCopyUpload)
+	{
+		const int SlotIndex = AcquireUploadSlot(InViewState);
+		if (SlotIndex < 0)
+		{
+			// the render thread has not mapped a slot for us yet
+			UploadFrontBuffer(InViewState);
+			return udE_Success;
+		}
+
+		if (bAsyncRender)
+		{
+			RenderWorker.submit(ViewState.ViewKey, [this, InViewState, SlotIndex] {
+				RenderUploadSlot(*InViewState, SlotIndex);
+			});
+		}
+		else
+		{
+			error = (udError)RenderUploadSlot(ViewState, SlotIndex);
+		}
+
+		UploadFrontBuffer(InViewState);
+		return error;
+	}
+
+	const int BackBufferIndex = 1 - ViewState.FrontBufferIndex;
+
+	// a freshly resized front buffer holds no image yet, so that frame is rendered inline
+	if (bAsyncRender && !bResized)
+	{
+		RenderWorker.submit(ViewState.ViewKey, [this, InViewState, BackBufferIndex] {
+			RenderFrame(*InViewState, BackBufferIndex);
+		});
+	}
+	else
+	{
+		error = (udError)RenderFrame(ViewState, BackBufferIndex);
+	}
+
+	UploadFrontBuffer(InViewState);
+	return error;
+}
+
+int CUdSDKComposite::RecreateTiles(FUdViewState& InViewState, int InTileCount)
+{
+	enum udError error = udE_Success;
+
+	InTileCount = FMath::Clamp(InTileCount, 1, FMath::Min(MaxRenderTiles, InViewState.Height));
+	if (InTileCount <= 1)
+	{
+		DestroyTiles(InViewState);
+		return error;
+	}
+
+	const FIntPoint Size(InViewState.Width, InViewState.Height);
+	if (InViewState.Tiles.Num() == InTileCount && InViewState.TilesSize == Size)
+	{
+		return error;
+	}
+
+	DestroyTiles(InViewState);
+
+	// another view may be rendering with the tile contexts, RenderMutex keeps the array stable for it
+	FScopeLock ScopeLock(&RenderMutex);
+	while (TileRenderers.Num() < InTileCount)
+	{
+		udRenderContext* pTileRenderer = nullptr;
+		error = udRenderContext_Create(pContext, &pTileRenderer);
 		if (error != udE_Success)
 		{
-			UDSDK_ERROR_MSG("udRenderTarget_SetTargets error : %s", GetError(error));
+			UDSDK_ERROR_MSG("udRenderContext_Create error : %s", GetError(error));
 			return error;
 		}
+		TileRenderers.Add(pTileRenderer);
+	}
 
-		error = udRenderTarget_SetMatrix(pRenderView, udRTM_Projection, ProjArray);
-		error = udRenderTarget_SetMatrix(pRenderView, udRTM_View, ViewArray);
+	InViewState.Tiles.SetNum(InTileCount);
+	for (int i = 0; i < InTileCount; i++)
+	{
+		FUdRenderTile& Tile = InViewState.Tiles[i];
+		Tile.Y = InViewState.Height * i / InTileCount;
+		Tile.Height = InViewState.Height * (i + 1) / InTileCount - Tile.Y;
+
+		error = udRenderTarget_Create(pContext, &Tile.pRenderView, TileRenderers[i], InViewState.Width, Tile.Height);
+		if (error != udE_Success)
+		{
+			UDSDK_ERROR_MSG("udRenderTarget_Create error : %s", GetError(error));
+			InViewState.Tiles.SetNum(i);
+			DestroyTiles(InViewState);
+			return error;
+		}
+	}
+	InViewState.TilesSize = Size;
+	return error;
+}
+
+void CUdSDKComposite::DestroyTiles(FUdViewState& InViewState)
+{
+	for (FUdRenderTile& Tile : InViewState.Tiles)
+	{
+		if (Tile.pRenderView)
+		{
+			enum udError error = udRenderTarget_Destroy(&Tile.pRenderView);
+			if (error != udE_Success)
+			{
+				UDSDK_ERROR_MSG("udRenderTarget_Destroy error : %s", GetError(error));
+			}
+			Tile.pRenderView = nullptr;
+		}
+	}
+	InViewState.Tiles.Reset();
+	InViewState.TilesSize = FIntPoint::ZeroValue;
+}
+
+void CUdSDKComposite::StampRenderKey(FUdViewState& InViewState) const
+{
+	// RenderMutex is held by the caller, so no streamer update falls between the render and these reads
+	InViewState.LastRenderKey.StreamerUpdateCount = StreamerUpdateCount;
+	InViewState.LastRenderKey.StreamerChangeCount = StreamerChangeCount;
+}
+
+int CUdSDKComposite::RenderTiles(FUdViewState& InViewState, void* InColorBuffer, uint32 InColorPitch, void* InDepthBuffer, uint32 InDepthPitch)
+{
+	enum udError error = udE_Success;
+
+	// both formats are 4 bytes per pixel, a pitch of 0 means tightly packed rows
+	const uint32 ColorPitch = InColorPitch ? InColorPitch : InViewState.Width * sizeof(FColor);
+	const uint32 DepthPitch = InDepthPitch ? InDepthPitch : InViewState.Width * sizeof(float);
+
+	for (FUdRenderTile& Tile : InViewState.Tiles)
+	{
+		error = udRenderTarget_SetTargetsWithPitch(Tile.pRenderView, (uint8*)InColorBuffer + Tile.Y * ColorPitch, 0xFF000000, (uint8*)InDepthBuffer + Tile.Y * DepthPitch, ColorPitch, DepthPitch);
+		if (error != udE_Success)
+		{
+			UDSDK_ERROR_MSG("udRenderTarget_SetTargetsWithPitch error : %s", GetError(error));
+			return error;
+		}
+
+		error = udRenderTarget_SetMatrix(Tile.pRenderView, udRTM_Projection, Tile.ProjArray);
+		error = udRenderTarget_SetMatrix(Tile.pRenderView, udRTM_View, InViewState.ViewArray);
 		if (error != udE_Success)
 		{
 			UDSDK_ERROR_MSG("udRenderTarget_SetMatrix error : %s", GetError(error));
 			return error;
 		}
+	}
+
+	{
+		FScopeLock ScopeLockRender(&RenderMutex);
+		auto RenderTile = [this, &InViewState](int InTileIndex) -> udError {
+			udRenderSettings renderOptions;
+			memset(&renderOptions, 0, sizeof(udRenderSettings));
+			renderOptions.pFilter = nullptr;
+			renderOptions.pointMode = udRCPM_Rectangles;
+			renderOptions.flags = GetRenderFlags(InViewState);
+			return udRenderContext_Render(TileRenderers[InTileIndex], InViewState.Tiles[InTileIndex].pRenderView, InViewState.VisibleInstances.GetData(), InViewState.VisibleInstances.Num(), &renderOptions);
+		};
+
+		const double StartTime = FPlatformTime::Seconds();
+
+		// the calling thread keeps claiming bands too: with every worker stuck in a load it renders
+		// them all itself rather than waiting, with RenderMutex held, for one to come free
+		TArray<udError, TInlineAllocator<MaxRenderTiles>> TileErrors;
+		TileErrors.Init(udE_Success, InViewState.Tiles.Num());
+		parallel_for(InViewState.Tiles.Num(), [&RenderTile, &TileErrors](int InTileIndex) {
+			TileErrors[InTileIndex] = RenderTile(InTileIndex);
+		});
+		for (const udError TileError : TileErrors)
+		{
+			if (TileError != udE_Success)
+				error = TileError;
+		}
+
+		InViewState.LastRenderTimeMs = (float)((FPlatformTime::Seconds() - StartTime) * 1000.0);
+		if (error != udE_Success)
+		{
+			UDSDK_ERROR_MSG("udRenderContext_Render error : %s", GetError(error));
+			return error;
+		}
+		StampRenderKey(InViewState);
+	}
+
+	return error;
+}
+
+int CUdSDKComposite::RenderTarget(FUdViewState& InViewState, void* InColorBuffer, uint32 InColorPitch, void* InDepthBuffer, uint32 InDepthPitch)
+{
+	if (InViewState.Tiles.Num() > 1)
+	{
+		const int error = RenderTiles(InViewState, InColorBuffer, InColorPitch, InDepthBuffer, InDepthPitch);
+		SET_DWORD_STAT(STAT_UdsRenderTiles, InViewState.Tiles.Num());
+		SET_FLOAT_STAT(STAT_UdsRenderTimeMs, InViewState.LastRenderTimeMs);
+		return error;
+	}
+
+	enum udError error = udE_Failure;
+
+	error = udRenderTarget_SetTargetsWithPitch(InViewState.pRenderView, InColorBuffer, 0xFF000000, InDepthBuffer, InColorPitch, InDepthPitch);
+	if (error != udE_Success)
+	{
+		UDSDK_ERROR_MSG("udRenderTarget_SetTargetsWithPitch error : %s", GetError(error));
+		return error;
+	}
+
+	error = udRenderTarget_SetMatrix(InViewState.pRenderView, udRTM_Projection, InViewState.ProjArray);
+	error = udRenderTarget_SetMatrix(InViewState.pRenderView, udRTM_View, InViewState.ViewArray);
+	if (error != udE_Success)
+	{
+		UDSDK_ERROR_MSG("udRenderTarget_SetMatrix error : %s", GetError(error));
+		return error;
+	}
+
+	{
+		FScopeLock ScopeLockRender(&RenderMutex);
 
 		udRenderPicking picking = {};
 
@@ -778,114 +2223,340 @@ int CUdSDKComposite::CaptureUDSImage(const FSceneView& View)
 		renderOptions.pPick = &picking;
 		renderOptions.pFilter = nullptr;
 		renderOptions.pointMode = udRCPM_Rectangles;
+		renderOptions.flags = GetRenderFlags(InViewState);
 
-		error = udRenderContext_Render(pRenderer, pRenderView, InstanceArray.GetData(), InstanceArray.Num(), &renderOptions);
+		const double StartTime = FPlatformTime::Seconds();
+		error = udRenderContext_Render(pRenderer, InViewState.pRenderView, InViewState.VisibleInstances.GetData(), InViewState.VisibleInstances.Num(), &renderOptions);
+		InViewState.LastRenderTimeMs = (float)((FPlatformTime::Seconds() - StartTime) * 1000.0);
+		SET_DWORD_STAT(STAT_UdsRenderTiles, 1);
+		SET_FLOAT_STAT(STAT_UdsRenderTimeMs, InViewState.LastRenderTimeMs);
 		if (error != udE_Success)
 		{
 			UDSDK_ERROR_MSG("udRenderContext_Render error : %s", GetError(error));
 			return error;
 		}
+		StampRenderKey(InViewState);
 
 
+		// left 0 for a miss or an index the resolver does not recognise
+		uint32 PickedUniqueID = 0;
 		if (picking.hit)
 		{
-		//	SetSelectedByModelIndex(picking.modelIndex, true);
+			ResolvePickedModel(InViewState, picking.modelIndex, PickedUniqueID);
 		}
+		InViewState.PickedUniqueID = PickedUniqueID;
+	}
 
+	return error;
+}
+
+int CUdSDKComposite::RenderFrame(FUdViewState& InViewState, int InBufferIndex)
+{
+	// only this call writes into the back buffer, so BulkDataMutex is not held while rendering
+	FUdFrameBuffer& BackBuffer = InViewState.FrameBuffers[InBufferIndex];
 
+	enum udError error = (udError)RenderTarget(InViewState, BackBuffer.ColorBulkData.GetData(), 0, BackBuffer.DepthBulkData.GetData(), 0);
+	if (error != udE_Success)
+	{
+		// the game thread only reads the key once this view's render is done
+		InViewState.LastRenderKey.bValid = false;
+		return error;
 	}
 
+	// reconstructed pixels may come from history anywhere on screen, so no mask for interleaved frames
+	if (CVarUdsCompositeTileMask.GetValueOnAnyThread() > 0 && InViewState.PendingFrame.TemporalFactor == FIntPoint(1, 1))
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsBuildTileMask);
+		UdBuildDepthTileMask(BackBuffer.DepthBulkData.GetData(), InViewState.Width, InViewState.Height, 0, BackBuffer.TileMask, BackBuffer.TileMaskSize);
+	}
+	else
+	{
+		BackBuffer.TileMask.Reset();
+		BackBuffer.TileMaskSize = FIntPoint::ZeroValue;
+	}
+
+	if (InViewState.bHalfDepth)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsPackDepth);
+		if (InViewState.PendingFrame.bReversedDepth)
+		{
+			// the float buffer is not uploaded in this mode, so it is converted in place
+			UdConvertDepthToDeviceZ(BackBuffer.DepthBulkData.GetData(), InViewState.Width, InViewState.Height, 0);
+		}
+		UdPackDepthHalf(BackBuffer.DepthBulkData.GetData(), InViewState.Width, InViewState.Height, 0, BackBuffer.DepthHalfBulkData.GetData(), 0);
+	}
+
+	{
+		FScopeLock ScopeLock(&InViewState.BulkDataMutex);
+		BackBuffer.Info = InViewState.PendingFrame;
+		InViewState.FrontBufferIndex = InBufferIndex;
+		InViewState.bFrontBufferDirty = true;
+	}
+
+	return error;
+}
+
+int CUdSDKComposite::RenderUploadSlot(FUdViewState& InViewState, int InSlotIndex)
+{
+	FUdUploadSlot& Slot = InViewState.UploadSlots[InSlotIndex];
+
+	enum udError error = (udError)RenderTarget(InViewState, Slot.pColorData, Slot.ColorStride, Slot.pDepthData, Slot.DepthStride);
+
+	Slot.Info = InViewState.PendingFrame;
+
+	// a failed render leaves the slot mapped so it is simply reused next frame
+	Slot.State = error == udE_Success ? UploadSlot_Rendered : UploadSlot_Mapped;
+	if (error != udE_Success)
+		InViewState.LastRenderKey.bValid = false;
+	return error;
+}
+
+int CUdSDKComposite::AcquireUploadSlot(const FUdViewStatePtr& InViewState)
+{
+	FUdUploadSlot* UploadSlots = InViewState->UploadSlots;
+
+	int MappedSlot = -1;
+	bool bMapping = false;
+	for (int i = 0; i < FUdViewState::UploadSlotCount; i++)
+	{
+		const int State = UploadSlots[i].State;
+		if (State == UploadSlot_Mapped && MappedSlot < 0)
+			MappedSlot = i;
+		else if (State == UploadSlot_Mapping)
+			bMapping = true;
+	}
+
+	if (MappedSlot >= 0)
+		UploadSlots[MappedSlot].State = UploadSlot_Rendering;
+
+	// keep one slot mapped ahead so the next frame does not wait for the render thread
+	if (!bMapping)
+	{
+		for (int i = 0; i < FUdViewState::UploadSlotCount; i++)
+		{
+			if (UploadSlots[i].State == UploadSlot_Free)
+			{
+				MapUploadSlot(InViewState, i);
+				break;
+			}
+		}
+	}
+
+	return MappedSlot;
+}
+
+void CUdSDKComposite::MapUploadSlot(const FUdViewStatePtr& InViewState, int InSlotIndex)
+{
+	InViewState->UploadSlots[InSlotIndex].State = UploadSlot_Mapping;
+
+	ENQUEUE_RENDER_COMMAND(MapUdsUploadSlot)(
+		[InViewState, InSlotIndex](FRHICommandListImmediate& CommandList) {
+		FUdUploadSlot& Slot = InViewState->UploadSlots[InSlotIndex];
+		Slot.pColorData = RHILockTexture2D(Slot.ColorTexture.GetReference(), 0, RLM_WriteOnly, Slot.ColorStride, false);
+		Slot.pDepthData = RHILockTexture2D(Slot.DepthTexture.GetReference(), 0, RLM_WriteOnly, Slot.DepthStride, false);
+		Slot.State = UploadSlot_Mapped;
+	});
+}
+
+void CUdSDKComposite::ReleaseUploadSlots(const FUdViewStatePtr& InViewState)
+{
+	bool bPendingUnlock = false;
+	for (FUdUploadSlot& Slot : InViewState->UploadSlots)
+	{
+		const int State = Slot.State;
+		if (State != UploadSlot_Free && State != UploadSlot_Presented)
+		{
+			ENQUEUE_RENDER_COMMAND(ReleaseUdsUploadSlot)(
+				[ColorTex = Slot.ColorTexture, DepthTex = Slot.DepthTexture](FRHICommandListImmediate& CommandList) {
+				RHIUnlockTexture2D(ColorTex.GetReference(), 0, false);
+				RHIUnlockTexture2D(DepthTex.GetReference(), 0, false);
+			});
+			bPendingUnlock = true;
+		}
+	}
+
+	// pending map commands reference the slots, let them drain before the slots are reset
+	if (bPendingUnlock)
+		FlushRenderingCommands();
+
+	for (FUdUploadSlot& Slot : InViewState->UploadSlots)
+	{
+		Slot.ColorTexture.SafeRelease();
+		Slot.DepthTexture.SafeRelease();
+		Slot.pColorData = nullptr;
+		Slot.pDepthData = nullptr;
+		Slot.ColorStride = 0;
+		Slot.DepthStride = 0;
+		Slot.State = UploadSlot_Free;
+	}
+	InViewState->bZeroCopyUpload = false;
+	InViewState->bUploadSlotsStaged = false;
+}
+
+void CUdSDKComposite::UploadFrontBuffer(const FUdViewStatePtr& InViewState)
+{
+	FUdViewState& ViewState = *InViewState;
+	if (ViewState.bZeroCopyUpload)
+	{
+		int RenderedSlot = -1;
+		for (int i = 0; i < FUdViewState::UploadSlotCount; i++)
+		{
+			if (ViewState.UploadSlots[i].State == UploadSlot_Rendered)
+			{
+				RenderedSlot = i;
+				break;
+			}
+		}
+		if (RenderedSlot < 0)
+			return;
+
+		for (FUdUploadSlot& Slot : ViewState.UploadSlots)
+		{
+			if (Slot.State == UploadSlot_Presented)
+				Slot.State = UploadSlot_Free;
+		}
+
+		FUdUploadSlot& Slot = ViewState.UploadSlots[RenderedSlot];
+		Slot.State = UploadSlot_Presented;
+		ViewState.ColorTexture = Slot.ColorTexture;
+		ViewState.DepthTexture = Slot.DepthTexture;
+		// what the unlock still copies when the RHI handed out a staging buffer instead of the texture
+		const uint32 BytesCopied = ViewState.bUploadSlotsStaged ? (Slot.ColorStride + Slot.DepthStride) * ViewState.Height : 0;
+
+		// unlocking is all that is left, udSDK has already written the pixels in place
+		ENQUEUE_RENDER_COMMAND(PresentUdsUploadSlot)(
+			[InViewState, ColorTex = Slot.ColorTexture, DepthTex = Slot.DepthTexture, Info = Slot.Info, BytesCopied](FRHICommandListImmediate& CommandList) {
+			RHIUnlockTexture2D(ColorTex.GetReference(), 0, false);
+			RHIUnlockTexture2D(DepthTex.GetReference(), 0, false);
+			INC_DWORD_STAT_BY(STAT_UdsUploadBytesCopied, BytesCopied);
+			// the pixels live in write-combined memory, too slow to scan for a tile mask
+			InViewState->PresentedFrame_RenderThread = Info;
+			InViewState->TileMask_RenderThread.Reset();
+			InViewState->TileMaskSize_RenderThread = FIntPoint::ZeroValue;
+		});
+		return;
+	}
+
+	if (!ViewState.bFrontBufferDirty.exchange(false))
+		return;
 
 	ENQUEUE_RENDER_COMMAND(UpdateTextureData)(
-		[this](FRHICommandListImmediate& CommandList) {
-		FScopeLock ScopeLock(&BulkDataMutex);
-		if (ColorTexture.IsValid() && ColorTexture->GetSizeX() == Width && ColorTexture->GetSizeY() == Height)
+		[InViewState](FRHICommandListImmediate& CommandList) {
+		FUdViewState& ViewState = *InViewState;
+		FScopeLock ScopeLock(&ViewState.BulkDataMutex);
+		FUdFrameBuffer& FrontBuffer = ViewState.FrameBuffers[ViewState.FrontBufferIndex];
+		const uint32 Width = ViewState.Width;
+		const uint32 Height = ViewState.Height;
+		uint32 BytesCopied = 0;
+		uint32 BytesSaved = 0;
+		if (ViewState.ColorTexture.IsValid() && ViewState.ColorTexture->GetSizeX() == Width && ViewState.ColorTexture->GetSizeY() == Height)
 		{
 			auto Region = FUpdateTextureRegion2D(0, 0, 0, 0, Width, Height);
-			RHIUpdateTexture2D(ColorTexture.GetReference(), 0, Region, ColorBulkData.GetTypeSize() * Region.Width, (uint8*)ColorBulkData.GetData());
-
-			//uint32 Stride = 0;
-			//void* TextureMemory = GDynamicRHI->LockTexture2D_RenderThread(CommandList, CoefColorTexture.GetReference(), 0, RLM_WriteOnly, Stride, false);
-			//if (TextureMemory)
-			//{
-			//	FMemory::Memcpy(TextureMemory, ColorBulkData.GetData(), srceen_width * srceen_height * ColorBulkData.GetTypeSize());
-			//	GDynamicRHI->UnlockTexture2D_RenderThread(CommandList, CoefColorTexture.GetReference(), 0, true);
-			//}
+			RHIUpdateTexture2D(ViewState.ColorTexture.GetReference(), 0, Region, FrontBuffer.ColorBulkData.GetTypeSize() * Region.Width, (uint8*)FrontBuffer.ColorBulkData.GetData());
+			BytesCopied += FrontBuffer.ColorBulkData.GetTypeSize() * Region.Width * Region.Height;
 		}
-		if (DepthTexture.IsValid() && DepthTexture->GetSizeX() == Width && DepthTexture->GetSizeY() == Height)
+		if (ViewState.DepthTexture.IsValid() && ViewState.DepthTexture->GetSizeX() == Width && ViewState.DepthTexture->GetSizeY() == Height)
 		{
 			auto Region = FUpdateTextureRegion2D(0, 0, 0, 0, Width, Height);
-			RHIUpdateTexture2D(DepthTexture.GetReference(), 0, Region, DepthBulkData.GetTypeSize() * Region.Width, (uint8*)DepthBulkData.GetData());
-
-			//uint32 Stride = 0;
-			//void* TextureMemory = GDynamicRHI->LockTexture2D_RenderThread(CommandList, CoefDepthTexture.GetReference(), 0, RLM_WriteOnly, Stride, false);
-			//if (TextureMemory)
-			//{
-			//	FMemory::Memcpy(TextureMemory, DepthBulkData.GetData(), srceen_width * srceen_height * DepthBulkData.GetTypeSize());
-			//	GDynamicRHI->UnlockTexture2D_RenderThread(CommandList, CoefDepthTexture.GetReference(), 0, true);
-			//}
+			if (ViewState.bHalfDepth)
+			{
+				RHIUpdateTexture2D(ViewState.DepthTexture.GetReference(), 0, Region, FrontBuffer.DepthHalfBulkData.GetTypeSize() * Region.Width, (uint8*)FrontBuffer.DepthHalfBulkData.GetData());
+				BytesCopied += FrontBuffer.DepthHalfBulkData.GetTypeSize() * Region.Width * Region.Height;
+				BytesSaved += (FrontBuffer.DepthBulkData.GetTypeSize() - FrontBuffer.DepthHalfBulkData.GetTypeSize()) * Region.Width * Region.Height;
+			}
+			else
+			{
+				RHIUpdateTexture2D(ViewState.DepthTexture.GetReference(), 0, Region, FrontBuffer.DepthBulkData.GetTypeSize() * Region.Width, (uint8*)FrontBuffer.DepthBulkData.GetData());
+				BytesCopied += FrontBuffer.DepthBulkData.GetTypeSize() * Region.Width * Region.Height;
+			}
 		}
+		ViewState.PresentedFrame_RenderThread = FrontBuffer.Info;
+		ViewState.TileMask_RenderThread = FrontBuffer.TileMask;
+		ViewState.TileMaskSize_RenderThread = FrontBuffer.TileMaskSize;
+		INC_DWORD_STAT_BY(STAT_UdsUploadBytesCopied, BytesCopied);
+		INC_DWORD_STAT_BY(STAT_UdsUploadBytesSaved, BytesSaved);
 	});
-	return error;
 }
 //PRAGMA_ENABLE_OPTIMIZATION
-int CUdSDKComposite::RecreateUDView(int InWidth, int InHeight, float InFOV)
+int CUdSDKComposite::RecreateUDView(const FUdViewStatePtr& InViewState, int InWidth, int InHeight, bool InZeroCopyUpload, bool InHalfDepth)
 {
 	enum udError error = udE_Success;
-	if (InWidth == Width && InHeight == Height)
+	FUdViewState& ViewState = *InViewState;
+	if (InWidth == ViewState.Width && InHeight == ViewState.Height && InZeroCopyUpload == ViewState.bZeroCopyUpload && InHalfDepth == ViewState.bHalfDepth)
 	{
 		return error;
 	}
 
-	Width = InWidth;
-	Height = InHeight;
-
-	const float MinZ = GNearClippingPlane;
-	const float MaxZ = MinZ;
-	const float ModifiedViewFOV = InFOV;
-	const float MatrixFOV = FMath::Max(0.001f, ModifiedViewFOV) * (float)PI / 360.0f;
-
-	float const XAxisMultiplier = 1.0f;
-	float const YAxisMultiplier = Width / (float)Height;
-
-	ProjectionMatrix = FPerspectiveMatrix(
-		MatrixFOV,
-		MatrixFOV,
-		XAxisMultiplier,
-		YAxisMultiplier,
-		MinZ,
-		MaxZ
-	);
+	ReleaseUploadSlots(InViewState);
+	ViewState.bZeroCopyUpload = InZeroCopyUpload;
 
 	{
-		FScopeLock ScopeLock(&BulkDataMutex);
+		// pending uploads read the size and the front buffer under this lock
+		FScopeLock ScopeLock(&ViewState.BulkDataMutex);
+		ViewState.Width = InWidth;
+		ViewState.Height = InHeight;
+		ViewState.bHalfDepth = InHalfDepth;
+
 		ETextureCreateFlags TexCreateFlags = TexCreate_Dynamic;
+		const int BulkDataSize = ViewState.bZeroCopyUpload ? 0 : ViewState.Width * ViewState.Height;
+		for (FUdFrameBuffer& Buffer : ViewState.FrameBuffers)
 		{
-			ColorBulkData.ResizeArray(Width * Height);
-			FRHIResourceCreateInfo CreateInfo;
-			ColorTexture = RHICreateTexture2D(Width, Height, EPixelFormat::PF_B8G8R8A8, 1, 1, TexCreateFlags, CreateInfo);
+			Buffer.ColorBulkData.ResizeArray(BulkDataSize);
+			Buffer.DepthBulkData.ResizeArray(BulkDataSize);
+			Buffer.DepthHalfBulkData.ResizeArray(ViewState.bHalfDepth ? BulkDataSize : 0);
+		}
+
+		if (ViewState.bZeroCopyUpload)
+		{
+			// the upload slots' textures are presented directly once the first one is rendered
+			ViewState.ColorTexture.SafeRelease();
+			ViewState.DepthTexture.SafeRelease();
 		}
+		else
+		{
+			{
+				FRHIResourceCreateInfo CreateInfo;
+				ViewState.ColorTexture = RHICreateTexture2D(ViewState.Width, ViewState.Height, EPixelFormat::PF_B8G8R8A8, 1, 1, TexCreateFlags, CreateInfo);
+			}
 
+			{
+				FRHIResourceCreateInfo CreateInfo;
+				ViewState.DepthTexture = RHICreateTexture2D(ViewState.Width, ViewState.Height, ViewState.bHalfDepth ? EPixelFormat::PF_R16F : EPixelFormat::PF_R32_FLOAT, 1, 1, TexCreateFlags, CreateInfo);
+			}
+		}
+
+		// the front buffer no longer holds a valid image at the new size
+		ViewState.bFrontBufferDirty = false;
+	}
+
+	if (ViewState.bZeroCopyUpload)
+	{
+		// CPU writable so D3D11 maps the texture itself, without it the lock goes through a staging copy.
+		// The other RHIs always lock textures through an upload buffer, that copy is counted when presenting
+		const ETextureCreateFlags SlotCreateFlags = TexCreate_Dynamic | TexCreate_CPUWritable;
+		ViewState.bUploadSlotsStaged = FCString::Strcmp(GDynamicRHI->GetName(), TEXT("D3D11")) != 0;
+		for (FUdUploadSlot& Slot : ViewState.UploadSlots)
 		{
-			DepthBulkData.ResizeArray(Width * Height);
 			FRHIResourceCreateInfo CreateInfo;
-			DepthTexture = RHICreateTexture2D(Width, Height, EPixelFormat::PF_R32_FLOAT, 1, 1, TexCreateFlags, CreateInfo);
+			Slot.ColorTexture = RHICreateTexture2D(ViewState.Width, ViewState.Height, EPixelFormat::PF_B8G8R8A8, 1, 1, SlotCreateFlags, CreateInfo);
+			Slot.DepthTexture = RHICreateTexture2D(ViewState.Width, ViewState.Height, EPixelFormat::PF_R32_FLOAT, 1, 1, SlotCreateFlags, CreateInfo);
 		}
+		MapUploadSlot(InViewState, 0);
 	}
 
-	if (pRenderView)
+	if (ViewState.pRenderView)
 	{
-		error = udRenderTarget_Destroy(&pRenderView);
+		error = udRenderTarget_Destroy(&ViewState.pRenderView);
 		if (error != udE_Success)
 		{
 			UDSDK_ERROR_MSG("udRenderTarget_Destroy error : %s", GetError(error));
 			return error;
 		}
-		pRenderView = nullptr;
+		ViewState.pRenderView = nullptr;
 	}
 
 
-	error = udRenderTarget_Create(pContext, &pRenderView, pRenderer, Width, Height);
+	error = udRenderTarget_Create(pContext, &ViewState.pRenderView, pRenderer, ViewState.Width, ViewState.Height);
 	if (error != udE_Success)
 	{
 		UDSDK_ERROR_MSG("udRenderTarget_Create error : %s", GetError(error));
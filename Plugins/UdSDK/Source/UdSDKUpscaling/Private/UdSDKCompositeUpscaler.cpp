@@ -1,6 +1,8 @@
 #include "UdSDKCompositeUpscaler.h"
 
 #include "Subpasses/UdsSubpassFirst.h"
+#include "Subpasses/UdsSubpassTemporal.h"
+#include "Subpasses/UdsSubpassUpscale.h"
 #include "Subpasses/UdsSubpassComposite.h"
 #include "Subpasses/UdsSubpassLast.h"
 
@@ -23,6 +25,11 @@ FUdSDKCompositeUpscaler::FUdSDKCompositeUpscaler(EUdsMode InMode, TArray<TShared
 		// ensure this subpass always runs first
 		RegisterSubpass<FUdsSubpassFirst>();
 
+		// rebuilds the full interleaved image before it gets upscaled
+		RegisterSubpass<FUdsSubpassTemporal>();
+
+		RegisterSubpass<FUdsSubpassUpscale>();
+
 		RegisterSubpass<FUdsSubpassComposite>();
 
 		// ensure this subpass always runs last.
@@ -63,6 +70,11 @@ FScreenPassTexture FUdSDKCompositeUpscaler::AddPasses(FRDGBuilder& GraphBuilder,
 	check(PassInputs.SceneColor.IsValid());
 
 	TSharedPtr<FUdsData> Data = GetDataForView(View);
+	if (!Data.IsValid())
+	{
+		// a view we were never asked to capture, composite nothing on top of it
+		Data = MakeShared<FUdsData>();
+	}
 	for (FUdsSubpass* Subpass : FUdsubpasses)
 	{
 		Subpass->SetData(Data.Get());
@@ -90,7 +102,7 @@ FScreenPassTexture FUdSDKCompositeUpscaler::AddPasses(FRDGBuilder& GraphBuilder,
 
 TSharedPtr<FUdsData> FUdSDKCompositeUpscaler::GetDataForView(const FViewInfo& View) const
 {
-	for (int i = 0; i < View.Family->Views.Num(); i++)
+	for (int i = 0; i < View.Family->Views.Num() && i < ViewData.Num(); i++)
 	{
 		if (View.Family->Views[i] == &View)
 		{
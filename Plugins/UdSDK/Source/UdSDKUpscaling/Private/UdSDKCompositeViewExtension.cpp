@@ -39,47 +39,25 @@ void FUdSDKCompositeViewExtension::BeginRenderViewFamily(FSceneViewFamily& InVie
 	{
 
 		TArray<TSharedPtr<FUdsData>> ViewData;
+		bool bAnyViewValid = false;
 
-		//for (int i = 0; i < InViewFamily.Views.Num(); i++)
+		// one entry per view, in family order, so the upscaler can match them up by index
+		for (int i = 0; i < InViewFamily.Views.Num(); i++)
 		{
-			//const FSceneView* InView = InViewFamily.Views[i];
+			const FSceneView* InView = InViewFamily.Views[i];
 
-
-			const FSceneView* InView = InViewFamily.Views[0];
+			FUdsData* Data = new FUdsData();
 			if (ensure(InView))
 			{
-				uint32 ViewIndex0 = 0;
-				uint32 ViewIndex1 = 1;
-				uint64 EditorViewBitflag0 = (uint64)1 << ViewIndex0;
-				uint64 EditorViewBitflag1 = (uint64)1 << ViewIndex1;
-#if WITH_EDITOR
-				EditorViewBitflag0 = InView->SceneViewInitOptions.EditorViewBitflag;
-				EditorViewBitflag1 = InView->SceneViewInitOptions.EditorViewBitflag;
-#endif
-				if (EditorViewBitflag0 == (uint64)1 << ViewIndex0 ||
-					EditorViewBitflag1 == (uint64)1 << ViewIndex1)
-				{
-					FUdsData* Data = new FUdsData();
-					if (CUdSDKComposite::Get())
-					{
-						CUdSDKComposite::Get()->CaptureUDSImage(*InView);
-						Data->UdColorTexture = CUdSDKComposite::Get()->GetColorTexture();
-						Data->UdDepthTexture = CUdSDKComposite::Get()->GetDepthTexture();
-					}
-
-					ViewData.Add(TSharedPtr<FUdsData>(Data));
-
-					if (CUdSDKComposite::Get()->IsValid())
-						InViewFamily.SetSecondarySpatialUpscalerInterface(new FUdSDKCompositeUpscaler(EUdsMode::PostProcessingOnly, ViewData));
-				}
-				
+				CUdSDKComposite::Get()->CaptureUDSImage(*InView, Data->UdColorTexture, Data->UdDepthTexture, Data->ViewState);
+				bAnyViewValid |= Data->UdColorTexture.IsValid() && Data->UdDepthTexture.IsValid();
 			}
-	
+
+			ViewData.Add(TSharedPtr<FUdsData>(Data));
 		}
 
-		
-		
-		
+		if (bAnyViewValid && CUdSDKComposite::Get()->IsValid())
+			InViewFamily.SetSecondarySpatialUpscalerInterface(new FUdSDKCompositeUpscaler(EUdsMode::Combined, ViewData));
 	}
 }
 //PRAGMA_ENABLE_OPTIMIZATION
@@ -0,0 +1,125 @@
+#include "UdSDKDepthKernels.h"
+#include "Math/VectorRegister.h"
+#include "Math/Float16.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+#include <arm_neon.h>
+#define UDS_HALF_NEON 1
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && defined(PLATFORM_ALWAYS_HAS_AVX_2) && PLATFORM_ALWAYS_HAS_AVX_2
+#include <immintrin.h>
+#define UDS_HALF_F16C 1
+#endif
+
+static TAutoConsoleVariable<int32> CVarUdsDepthKernelsScalar(
+	TEXT("r.Uds.DepthKernels.Scalar"),
+	0,
+	TEXT("Run the UDS CPU kernels (depth buffers, instance culling) with their scalar reference code instead of SIMD = 1 or 0"),
+	ECVF_Default);
+
+bool UdUseScalarKernels()
+{
+	return CVarUdsDepthKernelsScalar.GetValueOnAnyThread() > 0;
+}
+
+static FORCEINLINE const float* DepthRow(const float* InDepth, uint32 InPitch, int32 InY)
+{
+	return (const float*)((const uint8*)InDepth + InY * InPitch);
+}
+
+// a tile is two vectors wide, the columns past the last full tile go through the scalar code
+static_assert(UdDepthMaskTileSize == 8, "the vector loops cover a tile row with two 4-wide loads");
+
+int32 UdBuildDepthTileMask(const float* InDepth, int32 InWidth, int32 InHeight, uint32 InPitch, TArray<uint8>& OutMask, FIntPoint& OutMaskSize)
+{
+	const uint32 Pitch = InPitch ? InPitch : InWidth * sizeof(float);
+	OutMaskSize = FIntPoint(FMath::DivideAndRoundUp(InWidth, UdDepthMaskTileSize), FMath::DivideAndRoundUp(InHeight, UdDepthMaskTileSize));
+	OutMask.Reset(OutMaskSize.X * OutMaskSize.Y);
+	OutMask.AddZeroed(OutMaskSize.X * OutMaskSize.Y);
+
+	const int32 FullTiles = UdUseScalarKernels() ? 0 : InWidth / UdDepthMaskTileSize;
+	const VectorRegister One = VectorOne();
+
+	for (int32 y = 0; y < InHeight; y++)
+	{
+		const float* Row = DepthRow(InDepth, Pitch, y);
+		uint8* MaskRow = OutMask.GetData() + (y / UdDepthMaskTileSize) * OutMaskSize.X;
+
+		for (int32 TileX = 0; TileX < FullTiles; TileX++)
+		{
+			// once a tile is known to be covered the rest of its rows need not be read
+			if (MaskRow[TileX])
+				continue;
+
+			const float* Pixels = Row + TileX * UdDepthMaskTileSize;
+			const VectorRegister Covered = VectorBitwiseOr(VectorCompareLT(VectorLoad(Pixels), One), VectorCompareLT(VectorLoad(Pixels + 4), One));
+			MaskRow[TileX] = VectorMaskBits(Covered) != 0;
+		}
+
+		for (int32 x = FullTiles * UdDepthMaskTileSize; x < InWidth; x++)
+		{
+			MaskRow[x / UdDepthMaskTileSize] |= Row[x] < 1.0f;
+		}
+	}
+
+	int32 Count = 0;
+	for (const uint8 Tile : OutMask)
+	{
+		Count += Tile;
+	}
+	return Count;
+}
+
+void UdConvertDepthToDeviceZ(float* InOutDepth, int32 InWidth, int32 InHeight, uint32 InPitch)
+{
+	const uint32 Pitch = InPitch ? InPitch : InWidth * sizeof(float);
+	const int32 VectorWidth = UdUseScalarKernels() ? 0 : InWidth & ~3;
+	const VectorRegister One = VectorOne();
+	const VectorRegister Zero = VectorZero();
+
+	for (int32 y = 0; y < InHeight; y++)
+	{
+		float* Row = (float*)DepthRow(InOutDepth, Pitch, y);
+
+		int32 x = 0;
+		for (; x < VectorWidth; x += 4)
+		{
+			const VectorRegister Depth = VectorLoad(Row + x);
+			VectorStore(VectorSelect(VectorCompareLT(Depth, One), VectorSubtract(One, Depth), Zero), Row + x);
+		}
+		for (; x < InWidth; x++)
+		{
+			Row[x] = Row[x] < 1.0f ? 1.0f - Row[x] : 0.0f;
+		}
+	}
+}
+
+void UdPackDepthHalf(const float* InDepth, int32 InWidth, int32 InHeight, uint32 InPitch, uint16* OutHalf, uint32 OutPitch)
+{
+	const uint32 Pitch = InPitch ? InPitch : InWidth * sizeof(float);
+	const uint32 HalfPitch = OutPitch ? OutPitch : InWidth * sizeof(uint16);
+#if UDS_HALF_NEON || UDS_HALF_F16C
+	const int32 VectorWidth = UdUseScalarKernels() ? 0 : InWidth & ~3;
+#else
+	const int32 VectorWidth = 0;
+#endif
+
+	for (int32 y = 0; y < InHeight; y++)
+	{
+		const float* Row = DepthRow(InDepth, Pitch, y);
+		uint16* HalfRow = (uint16*)((uint8*)OutHalf + y * HalfPitch);
+
+		int32 x = 0;
+		for (; x < VectorWidth; x += 4)
+		{
+#if UDS_HALF_NEON
+			vst1_u16(HalfRow + x, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(Row + x))));
+#elif UDS_HALF_F16C
+			_mm_storel_epi64((__m128i*)(HalfRow + x), _mm_cvtps_ph(_mm_loadu_ps(Row + x), _MM_FROUND_TO_NEAREST_INT));
+#endif
+		}
+		for (; x < InWidth; x++)
+		{
+			HalfRow[x] = FFloat16(Row[x]).Encoded;
+		}
+	}
+}
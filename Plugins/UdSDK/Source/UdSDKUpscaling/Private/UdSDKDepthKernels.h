@@ -0,0 +1,24 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+//CPU passes over the udSDK bulk buffers (forward device Z depth, 1.0 = clear) run by the render worker
+//after udRenderContext_Render. Each one has a VectorRegister (SSE/NEON) body and a scalar reference,
+//r.Uds.DepthKernels.Scalar switches to the reference so the two can be compared with stat UdSDK.
+//Pitches are in bytes, 0 means tightly packed rows.
+
+//r.Uds.DepthKernels.Scalar, shared with the other kernel files
+bool UdUseScalarKernels();
+
+//Edge length in pixels of a tile of the UDS coverage mask
+static const int32 UdDepthMaskTileSize = 8;
+
+//Sets one byte per UdDepthMaskTileSize x UdDepthMaskTileSize tile of InDepth to 1 when any pixel
+//of it holds UDS depth, 0 otherwise. Returns the number of covered tiles
+int32 UdBuildDepthTileMask(const float* InDepth, int32 InWidth, int32 InHeight, uint32 InPitch, TArray<uint8>& OutMask, FIntPoint& OutMaskSize);
+
+//In place 1 - Depth, with clear pixels going to 0: the reversed Z device depth of the engine for an infinite projection
+void UdConvertDepthToDeviceZ(float* InOutDepth, int32 InWidth, int32 InHeight, uint32 InPitch);
+
+//Converts to half floats, OutHalf may have its own pitch
+void UdPackDepthHalf(const float* InDepth, int32 InWidth, int32 InHeight, uint32 InPitch, uint16* OutHalf, uint32 OutPitch);
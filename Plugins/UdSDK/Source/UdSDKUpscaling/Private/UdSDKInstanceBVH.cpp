@@ -0,0 +1,398 @@
+#include "UdSDKInstanceBVH.h"
+
+typedef TArray<int32, TInlineAllocator<64>> FUdNodeStack;
+
+static FORCEINLINE float HalfSurfaceArea(const FBox& InBox)
+{
+	const FVector Size = InBox.GetSize();
+	return Size.X * Size.Y + Size.Y * Size.Z + Size.Z * Size.X;
+}
+
+int32 FUdInstanceBVH::CreateProxy(const FBox& InBox, int32 InPayload)
+{
+	const int32 Leaf = AllocateNode();
+	Nodes[Leaf].Box = InBox;
+	Nodes[Leaf].Payload = InPayload;
+	InsertLeaf(Leaf);
+	ProxyCount++;
+	return Leaf;
+}
+
+void FUdInstanceBVH::DestroyProxy(int32 InProxy)
+{
+	check(Nodes.IsValidIndex(InProxy) && Nodes[InProxy].IsLeaf());
+	RemoveLeaf(InProxy);
+	FreeNode(InProxy);
+	ProxyCount--;
+}
+
+void FUdInstanceBVH::MoveProxy(int32 InProxy, const FBox& InBox)
+{
+	check(Nodes.IsValidIndex(InProxy) && Nodes[InProxy].IsLeaf());
+	const bool bNearby = Nodes[InProxy].Box.Intersect(InBox);
+	if (bNearby)
+	{
+		// a drag moves a little each frame, the ancestors just grow or shrink with it
+		Nodes[InProxy].Box = InBox;
+		FixUpwards(Nodes[InProxy].Parent);
+	}
+	else
+	{
+		RemoveLeaf(InProxy);
+		Nodes[InProxy].Box = InBox;
+		InsertLeaf(InProxy);
+	}
+}
+
+void FUdInstanceBVH::Reset()
+{
+	Nodes.Reset();
+	Root = INDEX_NONE;
+	FreeList = INDEX_NONE;
+	ProxyCount = 0;
+}
+
+int32 FUdInstanceBVH::AllocateNode()
+{
+	int32 Node = FreeList;
+	if (Node != INDEX_NONE)
+	{
+		FreeList = Nodes[Node].Parent;
+		Nodes[Node] = FNode();
+	}
+	else
+	{
+		Node = Nodes.Add(FNode());
+	}
+	return Node;
+}
+
+void FUdInstanceBVH::FreeNode(int32 InNode)
+{
+	Nodes[InNode].Parent = FreeList;
+	Nodes[InNode].Height = -1;
+	FreeList = InNode;
+}
+
+void FUdInstanceBVH::InsertLeaf(int32 InLeaf)
+{
+	if (Root == INDEX_NONE)
+	{
+		Root = InLeaf;
+		Nodes[Root].Parent = INDEX_NONE;
+		return;
+	}
+
+	// walk down to the sibling that makes the new parent cheapest, by surface area
+	const FBox LeafBox = Nodes[InLeaf].Box;
+	int32 Index = Root;
+	while (!Nodes[Index].IsLeaf())
+	{
+		const FNode& Node = Nodes[Index];
+		const float Area = HalfSurfaceArea(Node.Box);
+		const float CombinedArea = HalfSurfaceArea(Node.Box + LeafBox);
+
+		// a new parent here, or the least the leaf adds to every ancestor if it goes further down
+		const float Cost = 2.0f * CombinedArea;
+		const float InheritanceCost = 2.0f * (CombinedArea - Area);
+		auto DescendCost = [this, &LeafBox, InheritanceCost](int32 InChild) {
+			const FNode& Child = Nodes[InChild];
+			const float Grown = HalfSurfaceArea(Child.Box + LeafBox);
+			return (Child.IsLeaf() ? Grown : Grown - HalfSurfaceArea(Child.Box)) + InheritanceCost;
+		};
+		const float Cost1 = DescendCost(Node.Child1);
+		const float Cost2 = DescendCost(Node.Child2);
+
+		if (Cost < Cost1 && Cost < Cost2)
+			break;
+		Index = Cost1 < Cost2 ? Node.Child1 : Node.Child2;
+	}
+
+	const int32 Sibling = Index;
+	const int32 OldParent = Nodes[Sibling].Parent;
+	// may grow Nodes, no references are held across it
+	const int32 NewParent = AllocateNode();
+	FNode& Parent = Nodes[NewParent];
+	Parent.Parent = OldParent;
+	Parent.Box = LeafBox + Nodes[Sibling].Box;
+	Parent.Height = Nodes[Sibling].Height + 1;
+	Parent.Child1 = Sibling;
+	Parent.Child2 = InLeaf;
+
+	if (OldParent != INDEX_NONE)
+	{
+		if (Nodes[OldParent].Child1 == Sibling)
+			Nodes[OldParent].Child1 = NewParent;
+		else
+			Nodes[OldParent].Child2 = NewParent;
+	}
+	else
+	{
+		Root = NewParent;
+	}
+	Nodes[Sibling].Parent = NewParent;
+	Nodes[InLeaf].Parent = NewParent;
+
+	FixUpwards(NewParent);
+}
+
+void FUdInstanceBVH::RemoveLeaf(int32 InLeaf)
+{
+	if (InLeaf == Root)
+	{
+		Root = INDEX_NONE;
+		return;
+	}
+
+	// the sibling takes the parent's place
+	const int32 Parent = Nodes[InLeaf].Parent;
+	const int32 GrandParent = Nodes[Parent].Parent;
+	const int32 Sibling = Nodes[Parent].Child1 == InLeaf ? Nodes[Parent].Child2 : Nodes[Parent].Child1;
+
+	Nodes[Sibling].Parent = GrandParent;
+	if (GrandParent != INDEX_NONE)
+	{
+		if (Nodes[GrandParent].Child1 == Parent)
+			Nodes[GrandParent].Child1 = Sibling;
+		else
+			Nodes[GrandParent].Child2 = Sibling;
+	}
+	else
+	{
+		Root = Sibling;
+	}
+	FreeNode(Parent);
+	Nodes[InLeaf].Parent = INDEX_NONE;
+
+	FixUpwards(GrandParent);
+}
+
+void FUdInstanceBVH::FixUpwards(int32 InNode)
+{
+	int32 Index = InNode;
+	while (Index != INDEX_NONE)
+	{
+		Index = Balance(Index);
+
+		FNode& Node = Nodes[Index];
+		const FNode& Child1 = Nodes[Node.Child1];
+		const FNode& Child2 = Nodes[Node.Child2];
+		Node.Height = 1 + FMath::Max(Child1.Height, Child2.Height);
+		Node.Box = Child1.Box + Child2.Box;
+
+		Index = Node.Parent;
+	}
+}
+
+int32 FUdInstanceBVH::Balance(int32 InNode)
+{
+	FNode& A = Nodes[InNode];
+	if (A.IsLeaf() || A.Height < 2)
+		return InNode;
+
+	const int32 IndexB = A.Child1;
+	const int32 IndexC = A.Child2;
+	FNode& B = Nodes[IndexB];
+	FNode& C = Nodes[IndexC];
+
+	// rotate the taller child up, A takes its shorter grandchild
+	auto RotateUp = [this, InNode, &A](int32 InUp, FNode& Up, FNode& Other, bool bUpIsChild2) {
+		const int32 IndexF = Up.Child1;
+		const int32 IndexG = Up.Child2;
+		FNode& F = Nodes[IndexF];
+		FNode& G = Nodes[IndexG];
+
+		Up.Child1 = InNode;
+		Up.Parent = A.Parent;
+		A.Parent = InUp;
+		if (Up.Parent != INDEX_NONE)
+		{
+			if (Nodes[Up.Parent].Child1 == InNode)
+				Nodes[Up.Parent].Child1 = InUp;
+			else
+				Nodes[Up.Parent].Child2 = InUp;
+		}
+		else
+		{
+			Root = InUp;
+		}
+
+		const bool bKeepF = F.Height > G.Height;
+		const int32 IndexKept = bKeepF ? IndexF : IndexG;
+		const int32 IndexMoved = bKeepF ? IndexG : IndexF;
+		FNode& Kept = Nodes[IndexKept];
+		FNode& Moved = Nodes[IndexMoved];
+
+		Up.Child2 = IndexKept;
+		if (bUpIsChild2)
+			A.Child2 = IndexMoved;
+		else
+			A.Child1 = IndexMoved;
+		Moved.Parent = InNode;
+
+		A.Box = Other.Box + Moved.Box;
+		Up.Box = A.Box + Kept.Box;
+		A.Height = 1 + FMath::Max(Other.Height, Moved.Height);
+		Up.Height = 1 + FMath::Max(A.Height, Kept.Height);
+		return InUp;
+	};
+
+	const int32 Imbalance = C.Height - B.Height;
+	if (Imbalance > 1)
+		return RotateUp(IndexC, C, B, true);
+	if (Imbalance < -1)
+		return RotateUp(IndexB, B, C, false);
+	return InNode;
+}
+
+void FUdInstanceBVH::CollectLeaves(int32 InNode, TArray<int32>& OutPayloads) const
+{
+	FUdNodeStack Stack;
+	Stack.Push(InNode);
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+		if (Node.IsLeaf())
+		{
+			OutPayloads.Add(Node.Payload);
+			continue;
+		}
+		Stack.Push(Node.Child1);
+		Stack.Push(Node.Child2);
+	}
+}
+
+void FUdInstanceBVH::QueryFrustum(const FVector4* InPlanes, int32 InPlaneCount, TArray<int32>& OutPayloads) const
+{
+	OutPayloads.Reset();
+	if (Root == INDEX_NONE)
+		return;
+
+	// each entry carries the planes its box still straddles, a box inside all of them is taken whole
+	TArray<TPair<int32, uint32>, TInlineAllocator<64>> Stack;
+	Stack.Push(TPair<int32, uint32>(Root, (1u << InPlaneCount) - 1));
+	while (Stack.Num() > 0)
+	{
+		const TPair<int32, uint32> Entry = Stack.Pop(false);
+		const FNode& Node = Nodes[Entry.Key];
+		uint32 Straddled = Entry.Value;
+
+		FVector Center, Extent;
+		Node.Box.GetCenterAndExtents(Center, Extent);
+		bool bOutside = false;
+		for (int32 p = 0; p < InPlaneCount && !bOutside; p++)
+		{
+			if (!(Straddled & (1u << p)))
+				continue;
+			const FVector4& Plane = InPlanes[p];
+			const float Distance = Center.X * Plane.X + Center.Y * Plane.Y + Center.Z * Plane.Z + Plane.W;
+			const float Radius = Extent.X * FMath::Abs(Plane.X) + Extent.Y * FMath::Abs(Plane.Y) + Extent.Z * FMath::Abs(Plane.Z);
+			if (Distance + Radius < 0.0f)
+				bOutside = true;
+			else if (Distance - Radius >= 0.0f)
+				Straddled &= ~(1u << p);
+		}
+		if (bOutside)
+			continue;
+
+		if (Node.IsLeaf())
+			OutPayloads.Add(Node.Payload);
+		else if (Straddled == 0)
+			CollectLeaves(Entry.Key, OutPayloads);
+		else
+		{
+			Stack.Push(TPair<int32, uint32>(Node.Child1, Straddled));
+			Stack.Push(TPair<int32, uint32>(Node.Child2, Straddled));
+		}
+	}
+}
+
+void FUdInstanceBVH::QueryRay(const FVector& InOrigin, const FVector& InDirection, float InMaxDistance, TArray<TPair<float, int32>>& OutHits) const
+{
+	OutHits.Reset();
+	if (Root == INDEX_NONE)
+		return;
+
+	// slab test, a zero direction component divides to +-inf and compares as it should
+	const FVector Direction = InDirection.GetSafeNormal();
+	const FVector InvDirection(1.0f / Direction.X, 1.0f / Direction.Y, 1.0f / Direction.Z);
+	auto Enter = [&InOrigin, &InvDirection, InMaxDistance](const FBox& InBox, float& OutDistance) {
+		const FVector T1 = (InBox.Min - InOrigin) * InvDirection;
+		const FVector T2 = (InBox.Max - InOrigin) * InvDirection;
+		const float Near = FMath::Max3(FMath::Min(T1.X, T2.X), FMath::Min(T1.Y, T2.Y), FMath::Min(T1.Z, T2.Z));
+		const float Far = FMath::Min3(FMath::Max(T1.X, T2.X), FMath::Max(T1.Y, T2.Y), FMath::Max(T1.Z, T2.Z));
+		OutDistance = FMath::Max(Near, 0.0f);
+		return Far >= OutDistance && OutDistance <= InMaxDistance;
+	};
+
+	FUdNodeStack Stack;
+	Stack.Push(Root);
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+		float Distance;
+		if (!Enter(Node.Box, Distance))
+			continue;
+
+		if (Node.IsLeaf())
+		{
+			OutHits.Add(TPair<float, int32>(Distance, Node.Payload));
+			continue;
+		}
+		Stack.Push(Node.Child1);
+		Stack.Push(Node.Child2);
+	}
+	OutHits.Sort([](const TPair<float, int32>& A, const TPair<float, int32>& B) { return A.Key < B.Key; });
+}
+
+void FUdInstanceBVH::QueryBox(const FBox& InBox, TArray<int32>& OutPayloads) const
+{
+	OutPayloads.Reset();
+	if (Root == INDEX_NONE)
+		return;
+
+	FUdNodeStack Stack;
+	Stack.Push(Root);
+	while (Stack.Num() > 0)
+	{
+		const int32 Index = Stack.Pop(false);
+		const FNode& Node = Nodes[Index];
+		if (!Node.Box.Intersect(InBox))
+			continue;
+
+		if (Node.IsLeaf())
+			OutPayloads.Add(Node.Payload);
+		else if (InBox.IsInside(Node.Box))
+			CollectLeaves(Index, OutPayloads);
+		else
+		{
+			Stack.Push(Node.Child1);
+			Stack.Push(Node.Child2);
+		}
+	}
+}
+
+void FUdInstanceBVH::QuerySphere(const FSphere& InSphere, TArray<int32>& OutPayloads) const
+{
+	OutPayloads.Reset();
+	if (Root == INDEX_NONE)
+		return;
+
+	const float RadiusSquared = FMath::Square(InSphere.W);
+	FUdNodeStack Stack;
+	Stack.Push(Root);
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+		if (!FMath::SphereAABBIntersection(InSphere.Center, RadiusSquared, Node.Box))
+			continue;
+
+		if (Node.IsLeaf())
+		{
+			OutPayloads.Add(Node.Payload);
+			continue;
+		}
+		Stack.Push(Node.Child1);
+		Stack.Push(Node.Child2);
+	}
+}
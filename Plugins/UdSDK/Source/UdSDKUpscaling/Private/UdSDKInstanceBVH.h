@@ -0,0 +1,59 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Dynamic bounding volume hierarchy over the world space boxes of the instances, in the manner of
+//Box2D's b2DynamicTree: a leaf goes where it grows the tree's surface area least, the tree is kept
+//balanced with rotations and a moved leaf is refitted in place. Every leaf carries an int32 payload,
+//the composite keeps the leaf's index in InstanceArray there. Not thread safe: the composite edits it
+//under DataMutex and hands the snapshots a copy that no longer changes.
+class FUdInstanceBVH
+{
+public:
+	//Returns the leaf's proxy id, stable until DestroyProxy
+	int32 CreateProxy(const FBox& InBox, int32 InPayload);
+	void DestroyProxy(int32 InProxy);
+	//A box that still overlaps the old one only refits the ancestors, a jump elsewhere reinserts the leaf
+	void MoveProxy(int32 InProxy, const FBox& InBox);
+	void SetPayload(int32 InProxy, int32 InPayload) { Nodes[InProxy].Payload = InPayload; }
+	void Reset();
+
+	int32 GetProxyCount() const { return ProxyCount; }
+	int32 GetHeight() const { return Root != INDEX_NONE ? Nodes[Root].Height : 0; }
+
+	//Payloads of the leaves touching every plane, Dot(P, Plane) + Plane.W >= 0 inside, see UdBuildFrustumPlanes
+	void QueryFrustum(const FVector4* InPlanes, int32 InPlaneCount, TArray<int32>& OutPayloads) const;
+	//The leaves the ray enters within InMaxDistance as (entry distance, payload), nearest first
+	void QueryRay(const FVector& InOrigin, const FVector& InDirection, float InMaxDistance, TArray<TPair<float, int32>>& OutHits) const;
+	void QueryBox(const FBox& InBox, TArray<int32>& OutPayloads) const;
+	void QuerySphere(const FSphere& InSphere, TArray<int32>& OutPayloads) const;
+
+private:
+	struct FNode
+	{
+		FBox Box;
+		//Next free node while the node is on the free list
+		int32 Parent = INDEX_NONE;
+		int32 Child1 = INDEX_NONE;
+		int32 Child2 = INDEX_NONE;
+		//0 for a leaf, -1 for a free node
+		int32 Height = 0;
+		int32 Payload = INDEX_NONE;
+
+		bool IsLeaf() const { return Child1 == INDEX_NONE; }
+	};
+
+	int32 AllocateNode();
+	void FreeNode(int32 InNode);
+	void InsertLeaf(int32 InLeaf);
+	void RemoveLeaf(int32 InLeaf);
+	//Rebalances and refits from InNode up to the root
+	void FixUpwards(int32 InNode);
+	int32 Balance(int32 InNode);
+	void CollectLeaves(int32 InNode, TArray<int32>& OutPayloads) const;
+
+	TArray<FNode> Nodes;
+	int32 Root = INDEX_NONE;
+	int32 FreeList = INDEX_NONE;
+	int32 ProxyCount = 0;
+};
@@ -0,0 +1,167 @@
+#include "UdSDKInstanceCulling.h"
+#include "UdSDKDepthKernels.h"
+#include "Math/VectorRegister.h"
+
+static void TransformBox(const double* InMatrix, const double* InCenter, const double* InExtent, float OutCenter[3], float OutExtent[3])
+{
+	// row vectors, translation in [12..14]: a box's center moves with the matrix, its extent with |M|
+	for (int j = 0; j < 3; j++)
+	{
+		double C = InMatrix[12 + j];
+		double E = 0.0;
+		for (int i = 0; i < 3; i++)
+		{
+			C += InCenter[i] * InMatrix[i * 4 + j];
+			E += InExtent[i] * FMath::Abs(InMatrix[i * 4 + j]);
+		}
+		OutCenter[j] = (float)C;
+		OutExtent[j] = (float)E;
+	}
+}
+
+FBox UdInstanceWorldBox(const double* InMatrix, const FVector& InCenter, const FVector& InExtent)
+{
+	const double Center[3] = { InCenter.X, InCenter.Y, InCenter.Z };
+	const double Extent[3] = { InExtent.X, InExtent.Y, InExtent.Z };
+	float WorldCenter[3];
+	float WorldExtent[3];
+	TransformBox(InMatrix, Center, Extent, WorldCenter, WorldExtent);
+	return FBox::BuildAABB(FVector(WorldCenter[0], WorldCenter[1], WorldCenter[2]), FVector(WorldExtent[0], WorldExtent[1], WorldExtent[2]));
+}
+
+void UdAddInstanceBounds(FUdInstanceBounds& OutBounds, const double* InMatrix, const udPointCloudHeader& InHeader, float InMaxDrawDistance)
+{
+	float Center[3];
+	float Extent[3];
+	TransformBox(InMatrix, InHeader.boundingBoxCenter, InHeader.boundingBoxExtents, Center, Extent);
+
+	OutBounds.CenterX.Add(Center[0]);
+	OutBounds.CenterY.Add(Center[1]);
+	OutBounds.CenterZ.Add(Center[2]);
+	OutBounds.ExtentX.Add(Extent[0]);
+	OutBounds.ExtentY.Add(Extent[1]);
+	OutBounds.ExtentZ.Add(Extent[2]);
+	OutBounds.MaxDistanceSquared.Add(InMaxDrawDistance > 0.0f ? InMaxDrawDistance * InMaxDrawDistance : MAX_flt);
+	OutBounds.Num++;
+}
+
+void UdFinishInstanceBounds(FUdInstanceBounds& OutBounds)
+{
+	// the padding is loaded but never reported, its values do not matter
+	const int32 Padded = Align(OutBounds.Num, 4);
+	for (TArray<float>* Array : { &OutBounds.CenterX, &OutBounds.CenterY, &OutBounds.CenterZ, &OutBounds.ExtentX, &OutBounds.ExtentY, &OutBounds.ExtentZ, &OutBounds.MaxDistanceSquared })
+	{
+		Array->SetNumZeroed(Padded);
+	}
+}
+
+int32 UdBuildFrustumPlanes(const FMatrix& InViewProjection, bool InHasFarPlane, FVector4 OutPlanes[6])
+{
+	// Clip = P * M, so each clip coordinate is P dotted with a column of M
+	auto Column = [&InViewProjection](int j) {
+		return FVector4(InViewProjection.M[0][j], InViewProjection.M[1][j], InViewProjection.M[2][j], InViewProjection.M[3][j]);
+	};
+	const FVector4 X = Column(0);
+	const FVector4 Y = Column(1);
+	const FVector4 Z = Column(2);
+	const FVector4 W = Column(3);
+
+	int32 Count = 0;
+	OutPlanes[Count++] = W + X;
+	OutPlanes[Count++] = W - X;
+	OutPlanes[Count++] = W + Y;
+	OutPlanes[Count++] = W - Y;
+	// forward Z: 0 on the near plane, W on the far one
+	OutPlanes[Count++] = Z;
+	if (InHasFarPlane)
+	{
+		OutPlanes[Count++] = W - Z;
+	}
+	return Count;
+}
+
+bool UdIsInstanceVisible(const FUdInstanceBounds& InBounds, int32 InIndex, const FVector4* InPlanes, int32 InPlaneCount, const FVector& InViewOrigin)
+{
+	const FVector Center(InBounds.CenterX[InIndex], InBounds.CenterY[InIndex], InBounds.CenterZ[InIndex]);
+	const FVector Extent(InBounds.ExtentX[InIndex], InBounds.ExtentY[InIndex], InBounds.ExtentZ[InIndex]);
+
+	const FVector Outside = ((Center - InViewOrigin).GetAbs() - Extent).ComponentMax(FVector::ZeroVector);
+	if (Outside.SizeSquared() > InBounds.MaxDistanceSquared[InIndex])
+		return false;
+
+	for (int32 p = 0; p < InPlaneCount; p++)
+	{
+		const FVector4& Plane = InPlanes[p];
+		const float Distance = Center.X * Plane.X + Center.Y * Plane.Y + Center.Z * Plane.Z + Plane.W;
+		const float Radius = Extent.X * FMath::Abs(Plane.X) + Extent.Y * FMath::Abs(Plane.Y) + Extent.Z * FMath::Abs(Plane.Z);
+		if (Distance + Radius < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+int32 UdCullInstances(const FUdInstanceBounds& InBounds, const FVector4* InPlanes, int32 InPlaneCount, const FVector& InViewOrigin, TArray<int32>& OutVisible)
+{
+	OutVisible.Reset(InBounds.Num);
+
+	// the padding of FUdInstanceBounds lets the last partial group go through the vector loop too
+	const int32 VectorNum = UdUseScalarKernels() ? 0 : Align(InBounds.Num, 4);
+	if (VectorNum > 0)
+	{
+		const VectorRegister Zero = VectorZero();
+		const VectorRegister OriginX = VectorSetFloat1(InViewOrigin.X);
+		const VectorRegister OriginY = VectorSetFloat1(InViewOrigin.Y);
+		const VectorRegister OriginZ = VectorSetFloat1(InViewOrigin.Z);
+
+		VectorRegister PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+		VectorRegister AbsX[6], AbsY[6], AbsZ[6];
+		for (int32 p = 0; p < InPlaneCount; p++)
+		{
+			PlaneX[p] = VectorSetFloat1(InPlanes[p].X);
+			PlaneY[p] = VectorSetFloat1(InPlanes[p].Y);
+			PlaneZ[p] = VectorSetFloat1(InPlanes[p].Z);
+			PlaneW[p] = VectorSetFloat1(InPlanes[p].W);
+			AbsX[p] = VectorAbs(PlaneX[p]);
+			AbsY[p] = VectorAbs(PlaneY[p]);
+			AbsZ[p] = VectorAbs(PlaneZ[p]);
+		}
+
+		for (int32 i = 0; i < VectorNum; i += 4)
+		{
+			const VectorRegister CX = VectorLoad(InBounds.CenterX.GetData() + i);
+			const VectorRegister CY = VectorLoad(InBounds.CenterY.GetData() + i);
+			const VectorRegister CZ = VectorLoad(InBounds.CenterZ.GetData() + i);
+			const VectorRegister EX = VectorLoad(InBounds.ExtentX.GetData() + i);
+			const VectorRegister EY = VectorLoad(InBounds.ExtentY.GetData() + i);
+			const VectorRegister EZ = VectorLoad(InBounds.ExtentZ.GetData() + i);
+
+			// distance from the camera to the nearest point of the box
+			const VectorRegister DX = VectorMax(VectorSubtract(VectorAbs(VectorSubtract(CX, OriginX)), EX), Zero);
+			const VectorRegister DY = VectorMax(VectorSubtract(VectorAbs(VectorSubtract(CY, OriginY)), EY), Zero);
+			const VectorRegister DZ = VectorMax(VectorSubtract(VectorAbs(VectorSubtract(CZ, OriginZ)), EZ), Zero);
+			const VectorRegister DistanceSquared = VectorMultiplyAdd(DX, DX, VectorMultiplyAdd(DY, DY, VectorMultiply(DZ, DZ)));
+			VectorRegister Visible = VectorCompareGE(VectorLoad(InBounds.MaxDistanceSquared.GetData() + i), DistanceSquared);
+
+			for (int32 p = 0; p < InPlaneCount; p++)
+			{
+				const VectorRegister Distance = VectorMultiplyAdd(CX, PlaneX[p], VectorMultiplyAdd(CY, PlaneY[p], VectorMultiplyAdd(CZ, PlaneZ[p], PlaneW[p])));
+				const VectorRegister Radius = VectorMultiplyAdd(EX, AbsX[p], VectorMultiplyAdd(EY, AbsY[p], VectorMultiply(EZ, AbsZ[p])));
+				Visible = VectorBitwiseAnd(Visible, VectorCompareGE(VectorAdd(Distance, Radius), Zero));
+			}
+
+			const int32 Mask = VectorMaskBits(Visible);
+			for (int32 Lane = 0; Lane < 4; Lane++)
+			{
+				if ((Mask & (1 << Lane)) && i + Lane < InBounds.Num)
+					OutVisible.Add(i + Lane);
+			}
+		}
+	}
+
+	for (int32 i = VectorNum; i < InBounds.Num; i++)
+	{
+		if (UdIsInstanceVisible(InBounds, i, InPlanes, InPlaneCount, InViewOrigin))
+			OutVisible.Add(i);
+	}
+	return OutVisible.Num();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UdSDKInstanceSnapshot.h"
+
+//Culling of the render list before udRenderContext_Render, over the world space bounds a
+//snapshot keeps in FUdInstanceBounds. Like the depth kernels it has a VectorRegister body,
+//four instances per iteration, and a scalar reference picked with r.Uds.DepthKernels.Scalar.
+
+//World space box of the unit cube space box (InCenter, InExtent) moved by InMatrix (udRenderInstance::matrix)
+FBox UdInstanceWorldBox(const double* InMatrix, const FVector& InCenter, const FVector& InExtent);
+
+//Appends the box of the unit cube space bounds of InHeader moved by InMatrix (udRenderInstance::matrix)
+void UdAddInstanceBounds(FUdInstanceBounds& OutBounds, const double* InMatrix, const udPointCloudHeader& InHeader, float InMaxDrawDistance);
+
+//Pads the arrays for the vector loads once every instance was added
+void UdFinishInstanceBounds(FUdInstanceBounds& OutBounds);
+
+//The inward planes of the frustum of InViewProjection (forward Z), a point P is inside when
+//Dot(P, Plane) + Plane.W >= 0. The far plane is left out for an infinite projection. Returns the plane count
+int32 UdBuildFrustumPlanes(const FMatrix& InViewProjection, bool InHasFarPlane, FVector4 OutPlanes[6]);
+
+//The scalar test of UdCullInstances for one instance
+bool UdIsInstanceVisible(const FUdInstanceBounds& InBounds, int32 InIndex, const FVector4* InPlanes, int32 InPlaneCount, const FVector& InViewOrigin);
+
+//Indices of the instances whose box touches every plane and lies within its max draw distance of InViewOrigin
+int32 UdCullInstances(const FUdInstanceBounds& InBounds, const FVector4* InPlanes, int32 InPlaneCount, const FVector& InViewOrigin, TArray<int32>& OutVisible);
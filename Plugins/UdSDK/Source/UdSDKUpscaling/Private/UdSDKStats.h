@@ -0,0 +1,5 @@
+#pragma once
+
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("UdSDK"), STATGROUP_UdSDK, STATCAT_Advanced);
@@ -3,6 +3,7 @@
 #include "UdSDKUpscaling.h"
 #include "Interfaces/IPluginManager.h"
 #include "UdSDKComposite.h"
+#include "Actors/UdPointCloudTracker.h"
 
 #define LOCTEXT_NAMESPACE "FUdSDKUpscalingModule"
 
@@ -15,12 +16,16 @@ void FUdSDKUpscalingModule::StartupModule()
 
 	if (CUdSDKComposite::Get() == nullptr)
 		new CUdSDKComposite();
+	if (CUdPointCloudTracker::Get() == nullptr)
+		new CUdPointCloudTracker();
 }
 
 void FUdSDKUpscalingModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	if (CUdPointCloudTracker::Get())
+		delete CUdPointCloudTracker::Get();
 	if (CUdSDKComposite::Get())
 		delete CUdSDKComposite::Get();
 }
@@ -18,6 +18,10 @@ public:
 	virtual ~AUdPointCloud();
 
 	void UpdatePointCloudTransform(const FTransform& InScale);
+#if WITH_EDITOR
+	//Pushes a change of IsHiddenEd()/IsSelectedInEditor() to the composite, called by CUdPointCloudTracker
+	void SyncEditorState();
+#endif //WITH_EDITOR
 public:
 	UFUNCTION(BlueprintGetter, Category = "UdSDK")
 	FString GetUrl() const { return Url; }
@@ -34,8 +38,6 @@ protected:
 	virtual void BeginPlay() override;
 	virtual void OnConstruction(const FTransform& Transform) override;
 
-	virtual bool ShouldTickIfViewportsOnly() const override;
-	virtual void Tick(float DeltaTime) override;
 	virtual void BeginDestroy() override;
 	virtual void Destroyed() override;
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
@@ -57,6 +59,7 @@ private:
 	void ReloadPointCloud();
 	void DestroyPointCloud();
 	void SelectPointCloud(bool InSelect);
+	void ShowPointCloud(bool InVisible);
 	void LoginPointCloud();
 	void ExitPointCloud();
 private:
@@ -70,6 +73,10 @@ private:
 		Category = "UdSDK")
 	FString Url;
 
+	//Not rendered beyond this distance from the camera, 0 for no limit
+	UPROPERTY(EditAnywhere, Category = "UdSDK", meta = (ClampMin = "0", Units = "cm"))
+	float MaxDrawDistance = 0.0f;
+
 private:
 	uint8 bWasDuplicatedForPIE : 1;
 	uint8 bWasHiddenEd : 1;
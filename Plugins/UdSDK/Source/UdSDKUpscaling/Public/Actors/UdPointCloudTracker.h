@@ -0,0 +1,46 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "Utils/CSingleton.h"
+
+class AUdPointCloud;
+class ULevel;
+class UWorld;
+
+//Follows the editor state of every registered AUdPointCloud from one place, so the
+//actors do not tick. Selection and level visibility arrive as editor/world events, hiding
+//through the eye icon, layers or H arrives through the root component's render state being
+//recreated. The actors touched by those events are synced with CUdSDKComposite once per frame.
+class UDSDKUPSCALING_API CUdPointCloudTracker : public CSingleton<CUdPointCloudTracker>
+{
+public:
+	CUdPointCloudTracker();
+	~CUdPointCloudTracker();
+
+	//Game thread, from the root component's OnRegister/OnUnregister
+	void Register(AUdPointCloud* InPointCloud);
+	void Unregister(AUdPointCloud* InPointCloud);
+
+	//Any thread: the actor's hidden or selected state may have changed, checked on the next flush
+	void MarkDirty(AUdPointCloud* InPointCloud);
+
+private:
+	bool Flush(float InDeltaTime);
+	void OnSelectionChanged(UObject* InObject);
+	void OnLevelChanged(ULevel* InLevel, UWorld* InWorld);
+
+	//Game thread only
+	TSet<AUdPointCloud*> PointClouds;
+	//The tracked actors that were selected after the last selection event, to catch deselections
+	TSet<AUdPointCloud*> Selected;
+
+	FCriticalSection DirtyMutex;
+	TSet<AUdPointCloud*> Dirty;
+
+	FDelegateHandle TickerHandle;
+	FDelegateHandle SelectionChangedHandle;
+	FDelegateHandle SelectObjectHandle;
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+};
@@ -7,16 +7,48 @@
 #include "udError.h"
 #include "udRenderTarget.h"
 #include "udConfig.h"
+#include "udStreamer.h"
 #include "UdSDKMacro.h"
 #include "UdSDKDefine.h"
+#include "UdSDKViewState.h"
 #include "SceneView.h"
 #include "Utils/CSingleton.h"
 #include "Utils/CThreadPool.h"
+#include "Utils/CRenderWorker.h"
+#include "Utils/CTaskGroup.h"
+#include "Utils/CPeriodicWorker.h"
+#include "Utils/CAwaitable.h"
+#include "Containers/Queue.h"
+#include <atomic>
 
 DECLARE_MULTICAST_DELEGATE(FUdLoginDelegate);
 DECLARE_MULTICAST_DELEGATE(FUdExitDelegate);
 
+typedef std::function<void(int, int)>		FunLoadProgress;
+typedef std::shared_ptr<std::atomic<bool>>	FUdLoadTokenPtr;
+
+struct FUdLoadRequest
+{
+	uint32 UniqueID = 0;
+	TSharedPtr<FUdAsset> Asset;
+	//Called on a pool thread once the point cloud is in, not called when the load was cancelled
+	FunCP0 Func;
+	//Always called exactly once on the thread that ends the load, with its udError (udE_NothingToDo when cancelled)
+	std::function<void(int)> OnFinished;
+};
+
+#if UDSDK_WITH_COROUTINES
+//Where a coroutine continues after co_await on one of the *Async calls below
+enum class EUdResumeThread : uint8
+{
+	GameThread,
+	//The pool thread that finished the operation
+	AnyThread
+};
+#endif
+
 class FUdSDKCompositeViewExtension;
+class FUdInstanceBVH;
 class CUdSDKComposite : public CSingleton<CUdSDKComposite>
 {
 public:
@@ -27,8 +59,11 @@ public:
 	int Login();
 	int Exit();
 
-	int Load(uint32 InUniqueID, TSharedPtr<FUdAsset> OutAssert);
+	int Load(uint32 InUniqueID, TSharedPtr<FUdAsset> OutAssert, const FUdLoadTokenPtr& InCancelToken = nullptr);
 	int AsyncLoad(uint32 InUniqueID, TSharedPtr<FUdAsset> OutAssert, const FunCP0& InFunc = nullptr);
+	//Queues many loads at once, nearest to the camera first and at most r.Uds.MaxConcurrentLoads at a time.
+	//InProgress receives (finished, total) on a pool thread after each load of the batch ends or is cancelled
+	int LoadBatch(const TArray<FUdLoadRequest>& InRequests, const FunLoadProgress& InProgress = nullptr);
 
 	int Remove(uint32 InUniqueID);
 	int AsyncRemove(uint32 InUniqueID,const FunCP0 & InFunc = nullptr);
@@ -36,33 +71,54 @@ public:
 	bool Find(uint32 InUniqueID);
 	int AsyncFind(uint32 InUniqueID, const FunCP1& InFunc = nullptr);
 
+#if UDSDK_WITH_COROUTINES
+	//co_await-able versions of AsyncLoad/AsyncRemove/AsyncFind. They go through the same
+	//load queue and per-actor ordering, LoadAsync yields the udError (udE_NothingToDo when cancelled)
+	CCallbackAwaitable<int> LoadAsync(uint32 InUniqueID, TSharedPtr<FUdAsset> InAsset, EUdResumeThread InResumeOn = EUdResumeThread::GameThread);
+	CCallbackAwaitable<int> RemoveAsync(uint32 InUniqueID, EUdResumeThread InResumeOn = EUdResumeThread::GameThread);
+	CCallbackAwaitable<bool> FindAsync(uint32 InUniqueID, EUdResumeThread InResumeOn = EUdResumeThread::GameThread);
+#endif
+
 	int AsyncSetTransform(uint32 InUniqueID, const FTransform& InTransform);
 	int SetTransform(uint32 InUniqueID, const FTransform& InTransform);
 
 	int AsyncSetSelected(uint32 InUniqueID, bool InSelect);
 	int SetSelected(uint32 InUniqueID, bool InSelect);
-	int SetSelectedByModelIndex(uint32 InModelIndex, bool InSelect);
+	//InModelIndex is udRenderPicking::modelIndex of the last render of InViewState
+	int SetSelectedByModelIndex(const FUdViewState& InViewState, uint32 InModelIndex, bool InSelect);
+	//udRenderPicking::modelIndex indexes the culled VisibleInstances of the view's render, not the
+	//instance table. False when the index does not come from that render
+	static bool ResolvePickedModel(const FUdViewState& InViewState, uint32 InModelIndex, uint32& OutUniqueID);
 
-	bool IsLogin() const {
-		return LoginFlag;
-	};
+	//0 for no limit, see r.Uds.Culling
+	int AsyncSetMaxDrawDistance(uint32 InUniqueID, float InDistance);
+	int SetMaxDrawDistance(uint32 InUniqueID, float InDistance);
 
-	FTexture2DRHIRef GetColorTexture()const {
-		return ColorTexture;
-	};
+	//A hidden instance is left out of the render but its model stays loaded, so showing it
+	//again is immediate unless it was evicted under r.Uds.Streamer.MemoryBudgetMB in between,
+	//then the model is queued back in like a load
+	int AsyncSetVisible(uint32 InUniqueID, bool InVisible);
+	int SetVisible(uint32 InUniqueID, bool InVisible);
+
+	//World space queries over the visible instances' bounds, for picking and editor selection
+	//before anything is asked of udSDK. Game thread, the pending transforms are applied first.
+	//The ray returns the nearest box first
+	int QueryRay(const FVector& InOrigin, const FVector& InDirection, float InMaxDistance, TArray<uint32>& OutUniqueIDs);
+	int QueryBox(const FBox& InBox, TArray<uint32>& OutUniqueIDs);
+	int QuerySphere(const FSphere& InSphere, TArray<uint32>& OutUniqueIDs);
 
-	FTexture2DRHIRef GetDepthTexture()const {
-		return DepthTexture;
+	bool IsLogin() const {
+		return LoginFlag;
 	};
 
 	bool IsValid()const {
 		return IsLogin() &&
-			GetColorTexture().IsValid() &&
-			GetDepthTexture().IsValid() && 
 			InstanceArray.Num() > 0;
 	};
 
-	int CaptureUDSImage(const FSceneView& View);
+	int CaptureUDSImage(const FSceneView& View, FTexture2DRHIRef& OutColorTexture, FTexture2DRHIRef& OutDepthTexture, FUdViewStatePtr& OutViewState);
+
+	static uint64 GetViewKey(const FSceneView& View);
 
 	FUdLoginDelegate LoginDelegate;
 	FUdExitDelegate ExitFrontDelegate;
@@ -72,13 +128,52 @@ public:
 	static uint32 GetSelectColor();
 private:
 	int Init();
-	int RecreateUDView(int InWidth, int InHeight, float InFOV);
+	FUdInstanceSnapshotPtr GetInstanceSnapshot();
+	void RemoveInstanceAt(int32 InIndex);
+	void ResetInstances();
+	FUdInstanceBVH& GetMutableInstanceBVH();
+	FBox GetInstanceWorldBox(int32 InIndex) const;
+	void GatherVisibleIds(const TArray<int32>& InSlots, TArray<uint32>& OutUniqueIDs) const;
+	static FString NormalizeModelUrl(const FString& InUrl);
+	int AcquireModel(const FString& InUrl, FUdModelPtr& OutModel);
+	struct FUdLoadBatch;
+	struct FUdPendingLoad;
+	void PushPendingLoad(FUdPendingLoad&& InLoad, TArray<FUdPendingLoad>& OutSuperseded);
+	void PumpLoads();
+	void RunLoad(const FUdPendingLoad& InLoad);
+	int RestoreEvictedModel(uint32 InUniqueID);
+	void CancelLoad(uint32 InUniqueID);
+	void CancelLoadLocked(uint32 InUniqueID, TArray<FUdPendingLoad>& OutCancelled);
+	void CancelAllLoads();
+	static void FinishLoad(const FUdPendingLoad& InLoad, int InResult);
+	void ApplyPendingTransforms();
+	void UpdateStreamer();
+	void UpdateStreamingBudget();
+	bool EvictHiddenModel(double InNow);
+	void UpdateInstanceTransform(uint32 InUniqueID, const FTransform& InTransform, FUdInstanceBVH& InBVH);
+	FUdViewStatePtr FindOrAddViewState(uint64 InViewKey);
+	void TrimViewStates();
+	void DestroyViewState(const FUdViewStatePtr& InViewState);
+	float UpdateRenderScale(FUdViewState& InViewState);
+	int CaptureViewState(const FUdViewStatePtr& InViewState, const FSceneView& View, uint32 InWidth, uint32 InHeight);
+	void CullInstances(FUdViewState& InViewState, const FMatrix& InViewProjection, bool InHasFarPlane, const FVector& InViewOrigin);
+	int RecreateUDView(const FUdViewStatePtr& InViewState, int InWidth, int InHeight, bool InZeroCopyUpload, bool InHalfDepth);
+	static FMatrix BuildProjectionMatrix(float InFOV, uint32 InWidth, uint32 InHeight, float InFarZ = 0.0f);
+	udRenderContextFlags GetRenderFlags(const FUdViewState& InViewState) const;
+	int RecreateTiles(FUdViewState& InViewState, int InTileCount);
+	void DestroyTiles(FUdViewState& InViewState);
+	int RenderTarget(FUdViewState& InViewState, void* InColorBuffer, uint32 InColorPitch, void* InDepthBuffer, uint32 InDepthPitch);
+	void StampRenderKey(FUdViewState& InViewState) const;
+	int RenderTiles(FUdViewState& InViewState, void* InColorBuffer, uint32 InColorPitch, void* InDepthBuffer, uint32 InDepthPitch);
+	int RenderFrame(FUdViewState& InViewState, int InBufferIndex);
+	int RenderUploadSlot(FUdViewState& InViewState, int InSlotIndex);
+	int AcquireUploadSlot(const FUdViewStatePtr& InViewState);
+	void MapUploadSlot(const FUdViewStatePtr& InViewState, int InSlotIndex);
+	void ReleaseUploadSlots(const FUdViewStatePtr& InViewState);
+	void UploadFrontBuffer(const FUdViewStatePtr& InViewState);
 	//int LoadThread(int id, int size, const TArray<TSharedPtr<FUdAsset>>& asserts);
 	
 private:
-	FTexture2DRHIRef ColorTexture;
-	FTexture2DRHIRef DepthTexture;
-
 	//bool InitFlag;
 	bool LoginFlag;
 
@@ -90,13 +185,10 @@ private:
 
 	struct udContext* pContext = NULL;
 	struct udRenderContext* pRenderer = NULL;
-	struct udRenderTarget* pRenderView = NULL;
-
-	double ViewArray[16] = {0};
-	double ProjArray[16] = {0};
-
-	int Width = 0;
-	int Height = 0;
+	//One per tile, shared by the views since their renders are serialized by RenderMutex
+	TArray<struct udRenderContext*> TileRenderers;
+	//udSDK render contexts are used by one render at a time
+	FCriticalSection RenderMutex;
 
 	bool LoadRunning;
 	//TArray<TSharedPtr<FUdAsset>> AssetArray;
@@ -105,15 +197,102 @@ private:
 	FCriticalSection DataMutex;
 
 	TArray<udRenderInstance> InstanceArray;
+	//Parallel to InstanceArray, owns the point clouds. Null for a hidden instance whose model was evicted
+	TArray<FUdModelRefPtr> InstanceModels;
+	struct FUdInstanceState
+	{
+		bool bVisible = true;
+		//FPlatformTime::Seconds() when it was hidden, the longest hidden model is evicted first
+		double HiddenSince = 0.0;
+		//Header bounds in unit cube space, kept here since the model may be evicted
+		FVector LocalCenter = FVector::ZeroVector;
+		FVector LocalExtent = FVector::ZeroVector;
+	};
+	//Parallel to InstanceArray
+	TArray<FUdInstanceState> InstanceStates;
+	//Dense slot map: UniqueID -> index into InstanceArray, and the back-pointer to fix it up on swap-remove
+	TMap<uint32, int32> InstanceIndices;
+	TArray<uint32> InstanceIds;
+	//Parallel to InstanceArray, the leaf of each instance in InstanceBVH, whose payload is the index back
+	TArray<int32> InstanceProxies;
+	//Shared with the snapshots. bInstanceBVHShared is set when a snapshot takes the tree: the first
+	//edit after that copies it, the rest of the generation edits the copy in place
+	std::shared_ptr<FUdInstanceBVH> InstanceBVH;
+	bool bInstanceBVHShared = false;
+	//Bumped by every edit of InstanceArray, the snapshot is rebuilt when it no longer matches
+	std::atomic<uint64> InstanceGeneration{ 1 };
+	FUdInstanceSnapshotPtr PublishedSnapshot;
+
+	//AsyncSetTransform only stages the move, the game thread applies the latest one per UniqueID before the next snapshot
+	TQueue<TPair<uint32, FTransform>, EQueueMode::Mpsc> PendingTransforms;
+	TMap<uint32, FTransform> CoalescedTransforms;
 	
 	//FCriticalSection AssetsMapMutex;
 	TMap<uint32, TSharedPtr<FUdAsset>> AssetsMap;
 
-	FCriticalSection BulkDataMutex;
-	FUdSDKResourceBulkData<FColor> ColorBulkData;
-	FUdSDKResourceBulkData<float> DepthBulkData;
+	//Loaded models by normalized url. A slot serializes the loads of its url, the
+	//model itself only lives as long as an instance or a snapshot holds it
+	struct FUdModelSlot
+	{
+		FCriticalSection LoadMutex;
+		std::weak_ptr<FUdModel> Model;
+	};
+	FCriticalSection ModelCacheMutex;
+	TMap<FString, std::shared_ptr<FUdModelSlot>> ModelCache;
+
+	struct FUdLoadBatch
+	{
+		int Total = 0;
+		std::atomic<int> Finished{ 0 };
+		FunLoadProgress Progress;
+	};
+	struct FUdPendingLoad
+	{
+		FUdLoadRequest Request;
+		FUdLoadTokenPtr CancelToken;
+		//Null for a model restored by SetVisible
+		std::shared_ptr<FUdLoadBatch> Batch;
+		//Brings back the model of an instance evicted while hidden instead of creating the instance
+		bool bRestoreModel = false;
+		//From PendingLoadsOrigin, the heap order of PendingLoads
+		float DistSquared = 0.0f;
+
+		bool operator<(const FUdPendingLoad& Other) const { return DistSquared < Other.DistSquared; }
+	};
+
+	//Loads waiting for a free slot as a heap, nearest first, the cancel token of every queued or running load
+	//and where the camera was last
+	FCriticalSection LoadMutex;
+	TArray<FUdPendingLoad> PendingLoads;
+	FVector PendingLoadsOrigin = FVector::ZeroVector;
+	TMap<uint32, FUdLoadTokenPtr> LoadTokens;
+	int ActiveLoads = 0;
+	FVector LastViewOrigin = FVector::ZeroVector;
+
+	//Render targets, buffers and textures per view, keyed by GetViewKey
+	TMap<uint64, FUdViewStatePtr> ViewStates;
+	uint64 LastTrimFrame = 0;
+
+	//With r.Uds.Streamer.ManualUpdate renders skip the streamer, StreamerWorker runs udStreamer_Update instead
+	std::atomic<bool> bManualStreamerUpdate{ false };
+	//Last udStreamerInfo, written by the streamer thread
+	std::atomic<int64> StreamerMemoryInUse{ 0 };
+	std::atomic<int32> StreamerStarvedMs{ 0 };
+	std::atomic<int32> StreamerModelsActive{ 0 };
+	std::atomic<uint32> StreamerUpdateCount{ 0 };
+	//Updates that were still streaming or changed the memory in use, see FUdRenderKey
+	std::atomic<uint32> StreamerChangeCount{ 0 };
+	//Bumped when an instance's selected flag changes, the voxel shader draws it without a new snapshot
+	std::atomic<uint32> SelectionGeneration{ 0 };
+	//Game thread only: how many of the farthest instances are left out of the snapshot to get back under the memory budget
+	int32 BudgetParkedCount = 0;
+	uint32 LastBudgetUpdateCount = 0;
+	double LastBudgetStepTime = 0.0;
+	CPeriodicWorker StreamerWorker;
 
-	FMatrix ProjectionMatrix;
+	CRenderWorker RenderWorker;
+	//Remove/Find/SetSelected and loads of one UniqueID run in the order they were issued
+	CSerialExecutor ActorExecutor;
 
 	TSharedPtr<FUdSDKCompositeViewExtension, ESPMode::ThreadSafe> ViewExtension;
 };
\ No newline at end of file
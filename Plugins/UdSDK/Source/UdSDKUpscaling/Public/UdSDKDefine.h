@@ -38,6 +38,8 @@ struct FUdAsset
 	uint32 select_color = 0xff0071c1;
 	bool geometry = 0;
 	double scale = 0;
+	//Not rendered beyond this distance from the camera, 0 for no limit
+	float max_draw_distance = 0;
 	void* pPointCloud = nullptr;
 };
 
@@ -0,0 +1,70 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "udPointCloud.h"
+#include "udRenderContext.h"
+#include "UdSDKDefine.h"
+#include <memory>
+
+//One loaded udPointCloud, shared by every instance whose url normalizes to the same
+//key, it is unloaded once the last instance and snapshot holding it let go
+struct FUdModel
+{
+	FUdModel(udPointCloud* InPointCloud, const udPointCloudHeader& InHeader)
+		: pPointCloud(InPointCloud)
+		, Header(InHeader)
+	{
+	}
+	~FUdModel();
+
+	udPointCloud* pPointCloud = nullptr;
+	//As udPointCloud_Load returned it, each instance works out its matrix from a copy
+	udPointCloudHeader Header;
+};
+
+typedef std::shared_ptr<FUdModel> FUdModelPtr;
+
+//What one instance holds: the shared model and the asset its voxel shader reads
+struct FUdModelRef
+{
+	FUdModelRef(const FUdModelPtr& InModel, const TSharedPtr<FUdAsset>& InAsset)
+		: Model(InModel)
+		, Asset(InAsset)
+	{
+	}
+
+	FUdModelPtr Model;
+	TSharedPtr<FUdAsset> Asset;
+};
+
+typedef std::shared_ptr<FUdModelRef> FUdModelRefPtr;
+
+class FUdInstanceBVH;
+
+//World space bounding boxes of the instances as structure of arrays, padded to a multiple
+//of 4 entries so the culling kernel can load them four at a time. See UdSDKInstanceCulling.h
+struct FUdInstanceBounds
+{
+	int32 Num = 0;
+	TArray<float> CenterX, CenterY, CenterZ;
+	TArray<float> ExtentX, ExtentY, ExtentZ;
+	//Squared max draw distance, MAX_flt for no limit
+	TArray<float> MaxDistanceSquared;
+};
+
+//Immutable copy of the instance table, a render works from one of these without
+//touching DataMutex while Load/Remove/SetTransform keep editing the live table
+struct FUdInstanceSnapshot
+{
+	uint64 Generation = 0;
+	TArray<udRenderInstance> Instances;
+	TArray<FUdModelRefPtr> Models;
+	//Parallel to Instances, what picking resolves to
+	TArray<uint32> UniqueIds;
+	FUdInstanceBounds Bounds;
+	//The instance tree as of Generation, its leaves hold the live table's indices of that time
+	std::shared_ptr<const FUdInstanceBVH> BVH;
+	//Live table index -> index into Instances, INDEX_NONE for the hidden and parked ones
+	TArray<int32> SlotToInstance;
+};
+
+typedef std::shared_ptr<const FUdInstanceSnapshot> FUdInstanceSnapshotPtr;
@@ -0,0 +1,171 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "RHI.h"
+#include "RendererInterface.h"
+#include "udRenderTarget.h"
+#include "UdSDKDefine.h"
+#include "UdSDKInstanceSnapshot.h"
+#include <atomic>
+
+//How a UDS image was rendered, travels with the pixels so the render thread
+//knows exactly which camera and jitter the presented image belongs to
+struct FUdFrameInfo
+{
+	uint32 FrameNumber = 0;
+	//Size the temporal pass reconstructs, the image itself is TargetSize / TemporalFactor
+	FIntPoint TargetSize = FIntPoint::ZeroValue;
+	FIntPoint TemporalFactor = FIntPoint(1, 1);
+	FIntPoint TemporalPhase = FIntPoint::ZeroValue;
+	//Without jitter
+	FMatrix ViewProjection = FMatrix::Identity;
+	FVector4 InvDeviceZToWorldZTransform = FVector4(0, 0, 0, 0);
+	//log2(Far + 1) when the depth was rendered with udRCF_LogarithmicDepth, 0 otherwise
+	float LogDepthScale = 0.0f;
+	//The depth was flipped to 1 - DeviceZ (clear = 0) for the half float upload, InvDeviceZToWorldZTransform matches it
+	bool bReversedDepth = false;
+};
+
+//What a render of a view depended on, the next frame is skipped when it would draw the same pixels
+struct FUdRenderKey
+{
+	double ViewArray[16] = { 0 };
+	double ProjArray[16] = { 0 };
+	uint64 InstanceGeneration = 0;
+	uint32 SelectionGeneration = 0;
+	uint32 SelectColor = 0;
+	uint32 RenderFlags = 0;
+	//Of the culled list, catches r.Uds.Culling changes that the matrices do not
+	uint32 VisibleHash = 0;
+	//Streamer updates so far, and those that loaded or dropped anything. The render overwrites both
+	//with the values it rendered against, only known with r.Uds.Streamer.ManualUpdate
+	bool bManualStreamer = false;
+	uint32 StreamerUpdateCount = 0;
+	uint32 StreamerChangeCount = 0;
+	//Cleared when the render failed
+	bool bValid = false;
+
+	//A streamer update has run since InLast was rendered and found nothing to bring in for it,
+	//so rendering this key again would not add a single new block
+	bool IsSameImage(const FUdRenderKey& InLast) const
+	{
+		return InLast.bValid && InLast.bManualStreamer && bManualStreamer
+			&& StreamerUpdateCount != InLast.StreamerUpdateCount && StreamerChangeCount == InLast.StreamerChangeCount
+			&& InstanceGeneration == InLast.InstanceGeneration && SelectionGeneration == InLast.SelectionGeneration
+			&& SelectColor == InLast.SelectColor && RenderFlags == InLast.RenderFlags && VisibleHash == InLast.VisibleHash
+			&& FMemory::Memcmp(ViewArray, InLast.ViewArray, sizeof(ViewArray)) == 0
+			&& FMemory::Memcmp(ProjArray, InLast.ProjArray, sizeof(ProjArray)) == 0;
+	}
+};
+
+struct FUdFrameBuffer
+{
+	FUdSDKResourceBulkData<FColor> ColorBulkData;
+	FUdSDKResourceBulkData<float> DepthBulkData;
+	//r.Uds.DepthFormat 1: DepthBulkData packed to half floats, what is uploaded instead of it
+	FUdSDKResourceBulkData<uint16> DepthHalfBulkData;
+	FUdFrameInfo Info;
+	//Which 8x8 tiles of DepthBulkData hold UDS pixels, empty when it was not built for this frame
+	TArray<uint8> TileMask;
+	FIntPoint TileMaskSize = FIntPoint::ZeroValue;
+};
+
+enum EUdUploadSlotState
+{
+	UploadSlot_Free,
+	UploadSlot_Mapping,
+	UploadSlot_Mapped,
+	UploadSlot_Rendering,
+	UploadSlot_Rendered,
+	UploadSlot_Presented
+};
+
+//Zero-copy upload: udSDK renders straight into locked texture memory, one slot
+//is presented, one is rendered into and one is mapped ahead by the render thread
+struct FUdUploadSlot
+{
+	FTexture2DRHIRef ColorTexture;
+	FTexture2DRHIRef DepthTexture;
+	void* pColorData = nullptr;
+	void* pDepthData = nullptr;
+	uint32 ColorStride = 0;
+	uint32 DepthStride = 0;
+	FUdFrameInfo Info;
+	std::atomic<int> State{ UploadSlot_Free };
+};
+
+//A horizontal band of the UDS image, rendered by its own render context so the
+//bands of one view can be rendered concurrently into the shared buffer
+struct FUdRenderTile
+{
+	struct udRenderTarget* pRenderView = nullptr;
+	int Y = 0;
+	int Height = 0;
+	double ProjArray[16] = { 0 };
+};
+
+//Everything a single view (viewport, split-screen player, stereo eye) needs to
+//render and present the UDS image without disturbing the other views
+struct FUdViewState
+{
+	static const int UploadSlotCount = 3;
+
+	uint64 ViewKey = 0;
+	uint64 LastUsedFrame = 0;
+
+	struct udRenderTarget* pRenderView = nullptr;
+
+	//Size of the UDS image, smaller than the view when a resolution scale is active
+	int Width = 0;
+	int Height = 0;
+
+	float AutoRenderScale = 1.0f;
+	std::atomic<float> LastRenderTimeMs{ 0.0f };
+
+	//Empty unless r.Uds.RenderTiles splits the image, the size they were built for
+	TArray<FUdRenderTile> Tiles;
+	FIntPoint TilesSize = FIntPoint::ZeroValue;
+
+	FMatrix ProjectionMatrix;
+	double ViewArray[16] = { 0 };
+	double ProjArray[16] = { 0 };
+
+	//Filled by the game thread before each render, copied into the buffer it renders to
+	FUdFrameInfo PendingFrame;
+	//The instances the next render draws, also keeps their point clouds loaded until then
+	FUdInstanceSnapshotPtr Snapshot;
+	//What of Snapshot survived culling, packed for udRenderContext_Render, and the Snapshot index of each entry
+	TArray<udRenderInstance> VisibleInstances;
+	TArray<int32> VisibleToSnapshot;
+	uint32 FrameCounter = 0;
+	//UniqueID under the pick position in the last single target render, 0 for none
+	std::atomic<uint32> PickedUniqueID{ 0 };
+	//Of the last render submitted for this view
+	FUdRenderKey LastRenderKey;
+
+	FTexture2DRHIRef ColorTexture;
+	FTexture2DRHIRef DepthTexture;
+
+	//The front buffer feeds RHIUpdateTexture2D, udSDK renders into the other one
+	FCriticalSection BulkDataMutex;
+	FUdFrameBuffer FrameBuffers[2];
+	int FrontBufferIndex = 0;
+	std::atomic<bool> bFrontBufferDirty{ false };
+
+	FUdUploadSlot UploadSlots[UploadSlotCount];
+	bool bZeroCopyUpload = false;
+	//The RHI cannot map the slot textures and copies them from a staging buffer of its own on unlock
+	bool bUploadSlotsStaged = false;
+	//DepthTexture is PF_R16F and filled from DepthHalfBulkData
+	bool bHalfDepth = false;
+
+	//Render thread only: the frame the textures currently hold and the temporal history built from it
+	FUdFrameInfo PresentedFrame_RenderThread;
+	TArray<uint8> TileMask_RenderThread;
+	FIntPoint TileMaskSize_RenderThread = FIntPoint::ZeroValue;
+	TRefCountPtr<IPooledRenderTarget> HistoryColor;
+	TRefCountPtr<IPooledRenderTarget> HistoryDepth;
+	FMatrix HistoryViewProjection = FMatrix::Identity;
+	uint32 HistoryFrameNumber = 0;
+};
+
+typedef TSharedPtr<FUdViewState, ESPMode::ThreadSafe> FUdViewStatePtr;
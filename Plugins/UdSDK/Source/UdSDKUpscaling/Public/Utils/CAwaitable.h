@@ -0,0 +1,121 @@
+#ifndef AWAITABLE_H
+#define AWAITABLE_H
+
+// C++20 coroutine glue for the callback style async calls of the plugin.
+// Only built when the compiler implements coroutines, UDSDK_WITH_COROUTINES is 0 otherwise.
+#if defined(__cpp_impl_coroutine)
+#define UDSDK_WITH_COROUTINES 1
+#else
+#define UDSDK_WITH_COROUTINES 0
+#endif
+
+#if UDSDK_WITH_COROUTINES
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "CThreadPool.h"
+
+// Return type of a coroutine that nobody waits on: it starts right away and
+// frees its frame when it runs off the end, like an enqueue_detached task.
+struct CFireAndForget {
+    struct promise_type {
+        CFireAndForget get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+// Hands the rest of a coroutine to someone else, e.g. the game thread. A plain
+// function so resuming costs no allocation of its own.
+typedef void (*FunResume)(std::coroutine_handle<> handle);
+
+// Awaits a callback based call. start() receives the completion callback and
+// must call it exactly once, from any thread; the coroutine then resumes
+// through resume, or inline on the completing thread when resume is null.
+// The result and the handle live in the awaiter, which sits in the coroutine
+// frame, and the completion callback captures only a pointer to it, so a
+// co_await allocates nothing as long as start's captures fit start_size.
+template<class T>
+class CCallbackAwaitable {
+public:
+    typedef std::function<void(T)> FunDone;
+    static const size_t start_size = 64;
+
+    template<class F>
+    CCallbackAwaitable(F&& start, FunResume resume = nullptr)
+    :resume(resume)
+    {
+        typedef typename std::decay<F>::type functor;
+        static_assert(sizeof(functor) <= start_size && alignof(functor) <= alignof(std::max_align_t), "start captures too much to be kept in the awaiter");
+        new (start_storage) functor(std::forward<F>(start));
+        start_run = &run_start<functor>;
+        start_destroy = &destroy_start<functor>;
+    }
+    // lives where it was created, the completion callback points at it
+    CCallbackAwaitable(const CCallbackAwaitable&) = delete;
+    CCallbackAwaitable& operator=(const CCallbackAwaitable&) = delete;
+    ~CCallbackAwaitable()
+    {
+        if (start_destroy)
+            start_destroy(start_storage);
+    }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        this->handle = handle;
+        // start may complete, and the coroutine resume and free this awaiter, before it
+        // returns: run_start moves it out first and nothing here is touched afterwards
+        void (*run)(void*, FunDone&&) = start_run;
+        start_destroy = nullptr;
+        run(start_storage, [this](T result) {
+            value = std::move(result);
+            if (resume)
+                resume(this->handle);
+            else
+                this->handle.resume();
+        });
+    }
+    T await_resume() { return std::move(value); }
+private:
+    template<class F> static void run_start(void* p, FunDone&& done)
+    {
+        F start(std::move(*static_cast<F*>(p)));
+        static_cast<F*>(p)->~F();
+        start(std::move(done));
+    }
+    template<class F> static void destroy_start(void* p) { static_cast<F*>(p)->~F(); }
+
+    alignas(std::max_align_t) unsigned char start_storage[start_size];
+    void (*start_run)(void*, FunDone&&) = nullptr;
+    void (*start_destroy)(void*) = nullptr;
+    FunResume resume;
+    std::coroutine_handle<> handle;
+    T value{};
+};
+
+// co_await resume_on_pool(prio) continues the coroutine on a pool thread
+struct resume_on_pool {
+    explicit resume_on_pool(ETaskPriority priority = ETaskPriority::Load) : priority(priority) {}
+
+    bool await_ready() const noexcept { return false; }
+    // false resumes right here when the pool is shutting down and takes nothing more
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        return CThreadPool::Get()->enqueue_detached_priority(priority, [handle] { handle.resume(); });
+    }
+    void await_resume() const noexcept {}
+
+    ETaskPriority priority;
+};
+
+#endif // UDSDK_WITH_COROUTINES
+
+#endif // AWAITABLE_H
@@ -0,0 +1,81 @@
+#ifndef PERIODIC_WORKER_H
+#define PERIODIC_WORKER_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+// A single dedicated thread that runs one job over and over at a cadence.
+// The interval is asked for again before every wait, so it can follow a cvar,
+// and stop() wakes the thread right away instead of waiting out the interval.
+class CPeriodicWorker {
+public:
+    CPeriodicWorker();
+    ~CPeriodicWorker();
+    //starts the thread, does nothing if it is already running
+    void start(std::function<int()> interval_ms, std::function<void()> job);
+    //blocks until the job in progress (if any) has finished and the thread is gone
+    void stop();
+    bool running() const { return worker.joinable(); }
+private:
+    std::thread worker;
+    std::function<int()> interval_ms;
+    std::function<void()> job;
+
+    // synchronization
+    std::mutex stop_mutex;
+    std::condition_variable condition;
+    bool stopping;
+};
+
+inline CPeriodicWorker::CPeriodicWorker()
+:stopping(false)
+{
+}
+
+inline void CPeriodicWorker::start(std::function<int()> interval, std::function<void()> task)
+{
+    if(worker.joinable())
+        return;
+
+    interval_ms = std::move(interval);
+    job = std::move(task);
+    stopping = false;
+    worker = std::thread(
+        [this]
+        {
+            for(;;)
+            {
+                job();
+
+                const int wait_ms = interval_ms ? interval_ms() : 0;
+                std::unique_lock<std::mutex> lock(this->stop_mutex);
+                this->condition.wait_for(lock, std::chrono::milliseconds(wait_ms > 1 ? wait_ms : 1), [this]{ return this->stopping; });
+                if(this->stopping)
+                    return;
+            }
+        }
+    );
+}
+
+inline void CPeriodicWorker::stop()
+{
+    if(!worker.joinable())
+        return;
+
+    {
+        std::unique_lock<std::mutex> lock(stop_mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    worker.join();
+}
+
+inline CPeriodicWorker::~CPeriodicWorker()
+{
+    stop();
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef RENDER_WORKER_H
+#define RENDER_WORKER_H
+
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+// A single dedicated thread that runs jobs one after another.
+// Every job carries a key (one per view); submit() refuses a new job while the
+// previous one with the same key is still in flight, so the caller keeps
+// presenting the last finished frame instead of queueing up stale ones.
+class CRenderWorker {
+public:
+    CRenderWorker();
+    ~CRenderWorker();
+    //returns false if the previous job with this key has not finished yet
+    bool submit(uint64_t key, std::function<void()> job);
+    //true while a job with this key is pending or running
+    bool busy(uint64_t key);
+    //block until the job with this key (if any) has finished
+    void wait(uint64_t key);
+    //block until every job has finished
+    void wait();
+private:
+    std::thread worker;
+    std::deque< std::pair<uint64_t, std::function<void()> > > jobs;
+    std::vector<uint64_t> in_flight;
+
+    // synchronization
+    std::mutex job_mutex;
+    std::condition_variable condition;
+    std::condition_variable idle_condition;
+    bool stop;
+};
+
+inline CRenderWorker::CRenderWorker()
+:stop(false)
+{
+    worker = std::thread(
+        [this]
+        {
+            for(;;)
+            {
+                std::pair<uint64_t, std::function<void()> > task;
+
+                {
+                    std::unique_lock<std::mutex> lock(this->job_mutex);
+                    this->condition.wait(lock, [this]{ return this->stop || !this->jobs.empty(); });
+                    if(this->stop && this->jobs.empty())
+                        return;
+                    task = std::move(this->jobs.front());
+                    this->jobs.pop_front();
+                }
+
+                task.second();
+
+                {
+                    std::unique_lock<std::mutex> lock(this->job_mutex);
+                    in_flight.erase(std::find(in_flight.begin(), in_flight.end(), task.first));
+                }
+                idle_condition.notify_all();
+            }
+        }
+    );
+}
+
+inline bool CRenderWorker::submit(uint64_t key, std::function<void()> task)
+{
+    {
+        std::unique_lock<std::mutex> lock(job_mutex);
+        if(stop || std::find(in_flight.begin(), in_flight.end(), key) != in_flight.end())
+            return false;
+        in_flight.push_back(key);
+        jobs.emplace_back(key, std::move(task));
+    }
+    condition.notify_one();
+    return true;
+}
+
+inline bool CRenderWorker::busy(uint64_t key)
+{
+    std::unique_lock<std::mutex> lock(job_mutex);
+    return std::find(in_flight.begin(), in_flight.end(), key) != in_flight.end();
+}
+
+inline void CRenderWorker::wait(uint64_t key)
+{
+    std::unique_lock<std::mutex> lock(job_mutex);
+    idle_condition.wait(lock, [this, key]{ return std::find(in_flight.begin(), in_flight.end(), key) == in_flight.end(); });
+}
+
+inline void CRenderWorker::wait()
+{
+    std::unique_lock<std::mutex> lock(job_mutex);
+    idle_condition.wait(lock, [this]{ return in_flight.empty(); });
+}
+
+// the destructor finishes the pending jobs and joins the thread
+inline CRenderWorker::~CRenderWorker()
+{
+    {
+        std::unique_lock<std::mutex> lock(job_mutex);
+        stop = true;
+    }
+    condition.notify_all();
+    if(worker.joinable())
+        worker.join();
+}
+
+#endif
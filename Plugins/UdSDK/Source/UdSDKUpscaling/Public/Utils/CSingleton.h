@@ -21,7 +21,7 @@ public:
 	}
 	static __forceinline Type &Inst()
 	{
-		assert(pointer != 0 && "CSingleton::Inst(): Pointer is NULL");
+		assert(Pointer != 0 && "CSingleton::Inst(): Pointer is NULL");
 		return *Pointer;
 	}
 
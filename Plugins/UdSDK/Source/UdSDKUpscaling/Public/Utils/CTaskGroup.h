@@ -0,0 +1,232 @@
+#ifndef TASK_GROUP_H
+#define TASK_GROUP_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <cstdint>
+#include <atomic>
+#include <type_traits>
+#include "CThreadPool.h"
+
+// A set of pool tasks that can be waited on together, with continuations that
+// start once every task run so far has finished.
+// wait_all() blocks, so don't call it from a task of the same pool.
+class CTaskGroup {
+public:
+    explicit CTaskGroup(ETaskPriority priority = ETaskPriority::Load);
+    template<class F>
+    void run(F&& f);
+    // runs f on the pool once the group is empty, right away if it already is
+    template<class F>
+    void then(F&& f);
+    void wait_all();
+private:
+    struct group_state {
+        std::mutex mutex;
+        std::condition_variable done;
+        int pending = 0;
+        std::vector<CTask> continuations;
+    };
+    static void finish(const std::shared_ptr<group_state>& state, ETaskPriority priority);
+
+    std::shared_ptr<group_state> state;
+    ETaskPriority priority;
+};
+
+inline CTaskGroup::CTaskGroup(ETaskPriority priority)
+:state(std::make_shared<group_state>()),
+priority(priority)
+{
+}
+
+template<class F>
+void CTaskGroup::run(F&& f)
+{
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->pending++;
+    }
+    std::shared_ptr<group_state> group = state;
+    const ETaskPriority task_priority = priority;
+    CTask task([group, task_priority, fn = std::forward<F>(f)]() mutable {
+        fn();
+        finish(group, task_priority);
+    });
+    // the pool is shutting down: run it here so wait_all() still returns
+    if (!CThreadPool::Get()->enqueue_task(std::move(task), priority) && task)
+        task();
+}
+
+template<class F>
+void CTaskGroup::then(F&& f)
+{
+    CTask continuation(std::forward<F>(f));
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        if (state->pending > 0)
+        {
+            state->continuations.emplace_back(std::move(continuation));
+            return;
+        }
+    }
+    if (!CThreadPool::Get()->enqueue_task(std::move(continuation), priority) && continuation)
+        continuation();
+}
+
+inline void CTaskGroup::wait_all()
+{
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [this]{ return state->pending == 0; });
+}
+
+inline void CTaskGroup::finish(const std::shared_ptr<group_state>& state, ETaskPriority priority)
+{
+    std::vector<CTask> continuations;
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        if (--state->pending > 0)
+            return;
+        continuations.swap(state->continuations);
+    }
+    state->done.notify_all();
+    for (CTask& continuation : continuations)
+    {
+        if (!CThreadPool::Get()->enqueue_task(std::move(continuation), priority) && continuation)
+            continuation();
+    }
+}
+
+
+// Runs f(i) for every i of [0, count) on the pool and the calling thread together, and
+// returns once all of them are done. Indices are claimed rather than handed out, so the
+// caller keeps taking them itself: when every worker is busy (say blocked in a load) it
+// ends up running the whole loop instead of waiting for one to come free. A helper task
+// that only starts afterwards finds nothing left and touches nothing but the shared count.
+template<class F>
+void parallel_for(int count, F&& f, ETaskPriority priority = ETaskPriority::Critical);
+
+struct parallel_for_state {
+    std::atomic<int> next{0};
+    int count = 0;
+    std::mutex mutex;
+    std::condition_variable done;
+    int finished = 0;
+};
+
+template<class F>
+void parallel_for(int count, F&& f, ETaskPriority priority)
+{
+    if (count <= 0)
+        return;
+
+    typedef typename std::remove_reference<F>::type functor;
+    std::shared_ptr<parallel_for_state> state = std::make_shared<parallel_for_state>();
+    state->count = count;
+    functor* fn = &f;
+
+    // fn is only used after a successful claim, and the caller does not return before every claimed index is finished
+    auto claim = [](const std::shared_ptr<parallel_for_state>& shared, functor* body) {
+        int ran = 0;
+        for (int i = shared->next++; i < shared->count; i = shared->next++, ++ran)
+            (*body)(i);
+        if (ran > 0)
+        {
+            std::unique_lock<std::mutex> lock(shared->mutex);
+            shared->finished += ran;
+            if (shared->finished == shared->count)
+                shared->done.notify_all();
+        }
+    };
+
+    for (int i = 1; i < count; ++i)
+        CThreadPool::Get()->enqueue_task(CTask([state, fn, claim] { claim(state, fn); }), priority);
+    claim(state, fn);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state] { return state->finished == state->count; });
+}
+
+
+// Runs the tasks submitted for one key strictly one after another in
+// submission order, while different keys still run in parallel on the pool.
+// A key only occupies a worker while it has work queued.
+class CSerialExecutor {
+public:
+    explicit CSerialExecutor(ETaskPriority priority = ETaskPriority::Load);
+    ~CSerialExecutor();
+    template<class F>
+    void submit(uint64_t key, F&& f);
+    // block until no key has work left
+    void wait_all();
+private:
+    void drain(uint64_t key);
+
+    std::unordered_map< uint64_t, std::unique_ptr<CTaskRing> > queues;
+
+    // synchronization
+    std::mutex mutex;
+    std::condition_variable idle_condition;
+    ETaskPriority priority;
+};
+
+inline CSerialExecutor::CSerialExecutor(ETaskPriority priority)
+:priority(priority)
+{
+}
+
+// the destructor lets every queued task finish, they still point at this executor
+inline CSerialExecutor::~CSerialExecutor()
+{
+    wait_all();
+}
+
+template<class F>
+void CSerialExecutor::submit(uint64_t key, F&& f)
+{
+    bool start = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::unique_ptr<CTaskRing>& ring = queues[key];
+        if (!ring)
+        {
+            ring.reset(new CTaskRing());
+            start = true;
+        }
+        ring->push_back(CTask(std::forward<F>(f)));
+    }
+    // a key that already has a drain running just got one more task appended
+    if (start && !CThreadPool::Get()->enqueue_task(CTask([this, key]{ drain(key); }), priority))
+        drain(key);
+}
+
+inline void CSerialExecutor::drain(uint64_t key)
+{
+    for(;;)
+    {
+        CTask task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto it = queues.find(key);
+            if (it->second->empty())
+            {
+                queues.erase(it);
+                if (queues.empty())
+                    idle_condition.notify_all();
+                return;
+            }
+            task = it->second->pop_front();
+        }
+        task();
+    }
+}
+
+inline void CSerialExecutor::wait_all()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle_condition.wait(lock, [this]{ return queues.empty(); });
+}
+
+#endif
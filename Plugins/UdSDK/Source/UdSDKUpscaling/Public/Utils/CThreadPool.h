@@ -2,14 +2,16 @@
 #define THREAD_POOL_H
 
 #include <vector>
-#include <queue>
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <future>
 #include <functional>
-#include <stdexcept>
+#include <type_traits>
+#include <new>
+#include <cstddef>
 #include "CSingleton.h"
 
 typedef std::function<void()>				FunCP0;
@@ -23,95 +25,437 @@ typedef std::function<void(bool)>			FunCP1;
 #define C_P5(__selector__,__target__, ...) std::bind(&__selector__,__target__, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5, ##__VA_ARGS__)
 
 
+// order in which idle workers pick tasks up
+enum class ETaskPriority : int {
+    Critical = 0,   // render work somebody is blocked on
+    Load,           // point cloud loads and actor updates, the default
+    Background,     // anything that can wait
+    Count
+};
+
+// A move-only void() callable that keeps small callables inline instead of on
+// the heap; a lambda capturing a few ids, a shared_ptr and a std::function fits.
+class CTask {
+public:
+    static const size_t inline_size = 96;
+
+    CTask() : ops(nullptr) {}
+
+    template<class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, CTask>::value>::type>
+    CTask(F&& f) : ops(nullptr)
+    {
+        typedef typename std::decay<F>::type functor;
+        if (sizeof(functor) <= inline_size && alignof(functor) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<functor>::value)
+        {
+            new (storage) functor(std::forward<F>(f));
+            ops = &inline_ops<functor>::table;
+        }
+        else
+        {
+            *reinterpret_cast<functor**>(storage) = new functor(std::forward<F>(f));
+            ops = &heap_ops<functor>::table;
+        }
+    }
+
+    CTask(CTask&& other) : ops(other.ops)
+    {
+        if (ops)
+        {
+            ops->move(storage, other.storage);
+            other.ops = nullptr;
+        }
+    }
+
+    CTask& operator=(CTask&& other)
+    {
+        if (this != &other)
+        {
+            reset();
+            ops = other.ops;
+            if (ops)
+            {
+                ops->move(storage, other.storage);
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    CTask(const CTask&) = delete;
+    CTask& operator=(const CTask&) = delete;
+
+    ~CTask() { reset(); }
+
+    void operator()() { ops->invoke(storage); }
+    explicit operator bool() const { return ops != nullptr; }
+
+    void reset()
+    {
+        if (ops)
+        {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+private:
+    struct ops_table {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void*);
+    };
+
+    template<class F> struct inline_ops {
+        static void invoke(void* p) { (*static_cast<F*>(p))(); }
+        static void move(void* dst, void* src) { new (dst) F(std::move(*static_cast<F*>(src))); static_cast<F*>(src)->~F(); }
+        static void destroy(void* p) { static_cast<F*>(p)->~F(); }
+        static const ops_table table;
+    };
+
+    template<class F> struct heap_ops {
+        static void invoke(void* p) { (**static_cast<F**>(p))(); }
+        static void move(void* dst, void* src) { *static_cast<F**>(dst) = *static_cast<F**>(src); }
+        static void destroy(void* p) { delete *static_cast<F**>(p); }
+        static const ops_table table;
+    };
+
+    alignas(std::max_align_t) unsigned char storage[inline_size];
+    const ops_table* ops;
+};
+
+template<class F> const CTask::ops_table CTask::inline_ops<F>::table = { &CTask::inline_ops<F>::invoke, &CTask::inline_ops<F>::move, &CTask::inline_ops<F>::destroy };
+template<class F> const CTask::ops_table CTask::heap_ops<F>::table = { &CTask::heap_ops<F>::invoke, &CTask::heap_ops<F>::move, &CTask::heap_ops<F>::destroy };
+
+
+// Growable ring of tasks, used as a deque that never frees its slots so a
+// steady stream of tasks costs no allocation once the ring is big enough.
+class CTaskRing {
+public:
+    CTaskRing() : head(0), count(0) {}
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    void push_back(CTask&& task)
+    {
+        if (count == slots.size())
+            grow();
+        slots[(head + count) % slots.size()] = std::move(task);
+        count++;
+    }
+    CTask pop_back()
+    {
+        count--;
+        return std::move(slots[(head + count) % slots.size()]);
+    }
+    CTask pop_front()
+    {
+        CTask task = std::move(slots[head]);
+        head = (head + 1) % slots.size();
+        count--;
+        return task;
+    }
+private:
+    void grow()
+    {
+        std::vector<CTask> bigger(slots.empty() ? 16 : slots.size() * 2);
+        for (size_t i = 0; i < count; ++i)
+            bigger[i] = std::move(slots[(head + i) % slots.size()]);
+        slots.swap(bigger);
+        head = 0;
+    }
+    std::vector<CTask> slots;
+    size_t head;
+    size_t count;
+};
+
+
+// Work-stealing pool: every worker owns a deque per priority. Tasks submitted
+// from a worker go to its own deque and are run newest first (cache warm),
+// tasks from other threads are spread round robin, and a worker that runs
+// dry steals the oldest task of the highest priority from the others.
 class CThreadPool : public CSingleton<CThreadPool> {
 public:
     CThreadPool(size_t);
+    // Once the pool is stopping (its destructor is draining the queues) nothing more is accepted:
+    // the futures of enqueue/enqueue_priority then report std::future_errc::broken_promise and
+    // the other calls return false, the task is dropped without running.
+    // enqueue/enqueue_priority still heap allocate a packaged_task and its shared state per call,
+    // only the detached, range and task paths below run without any per-task allocation.
+    template<class F, class... Args>
+    auto enqueue(F&& f, Args&&... args)
+        -> std::future<typename std::result_of<F(Args...)>::type>;
     template<class F, class... Args>
-    auto enqueue(F&& f, Args&&... args) 
+    auto enqueue_priority(ETaskPriority priority, F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
+    // fire and forget: no future, no shared state, small callables are not allocated at all
+    template<class F, class... Args>
+    bool enqueue_detached(F&& f, Args&&... args);
+    template<class F, class... Args>
+    bool enqueue_detached_priority(ETaskPriority priority, F&& f, Args&&... args);
+    // submit every callable of [first, last) at once, waking no more workers than there are tasks
+    template<class It>
+    bool enqueue_range(It first, It last, ETaskPriority priority = ETaskPriority::Load);
+    bool enqueue_task(CTask&& task, ETaskPriority priority = ETaskPriority::Load);
     ~CThreadPool();
 	//idle thread count
 	int idleCount();
 	//wait task count
 	int waitCount();
 private:
+    struct worker_queue {
+        std::mutex mutex;
+        CTaskRing tasks[(int)ETaskPriority::Count];
+    };
+
+    bool push(ETaskPriority priority, CTask&& task);
+    void wake(size_t count);
+    bool pop(size_t index, CTask& task);
+    void run(size_t index);
+    // index of the calling worker in this pool, -1 for outside threads
+    int current_worker() const;
+
     // need to keep track of threads so we can join them
     std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
-    
-    // synchronization
-    std::mutex queue_mutex;
+    // one set of deques per worker
+    std::vector< std::unique_ptr<worker_queue> > queues;
+
+    // synchronization, the sleep mutex only guards idle workers going to sleep
+    std::mutex sleep_mutex;
     std::condition_variable condition;
-    bool stop;
-	int task_count;
+    std::atomic<bool> stop;
+    std::atomic<int> queued_count;
+	std::atomic<int> task_count;
+	std::atomic<size_t> next_queue;
 	int thread_count;
+    // tasks enqueue_range hands to one deque under a single lock
+    static const size_t range_chunk = 16;
+};
+
+struct CThreadPoolWorkerId {
+    const CThreadPool* pool;
+    int index;
 };
- 
+
+inline CThreadPoolWorkerId& local_thread_pool_worker()
+{
+    static thread_local CThreadPoolWorkerId id = { nullptr, -1 };
+    return id;
+}
+
 // the constructor just launches some amount of workers
 inline CThreadPool::CThreadPool(size_t threads)
 :stop(false),
-task_count(0)
+queued_count(0),
+task_count(0),
+next_queue(0)
 {
+    if (threads == 0)
+        threads = 1;
     thread_count = (int)threads;
     for(size_t i = 0;i<threads;++i)
-        workers.emplace_back(
-            [this]
+        queues.emplace_back(new worker_queue());
+    for(size_t i = 0;i<threads;++i)
+        workers.emplace_back([this, i] { run(i); });
+}
+
+inline int CThreadPool::current_worker() const
+{
+    const CThreadPoolWorkerId& id = local_thread_pool_worker();
+    return id.pool == this ? id.index : -1;
+}
+
+inline void CThreadPool::run(size_t index)
+{
+    local_thread_pool_worker().pool = this;
+    local_thread_pool_worker().index = (int)index;
+
+    for(;;)
+    {
+        CTask task;
+        if (!pop(index, task))
+        {
+            std::unique_lock<std::mutex> lock(this->sleep_mutex);
+            if (this->queued_count > 0)
             {
-                for(;;)
-                {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock, [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-
-                    task();
-
-                    {
-                        std::unique_lock<std::mutex> lock(queue_mutex);
-                        task_count--;
-                    }
-                }
+                // counted but not found: another worker is between taking it and the decrement,
+                // give it the core instead of spinning on the count
+                lock.unlock();
+                std::this_thread::yield();
+                continue;
             }
-        );
+            this->condition.wait(lock, [this]{ return this->stop || this->queued_count > 0; });
+            if(this->stop && this->queued_count == 0)
+                return;
+            continue;
+        }
+
+        task();
+        task.reset();
+
+        task_count--;
+    }
+}
+
+inline bool CThreadPool::pop(size_t index, CTask& task)
+{
+    for (int priority = 0; priority < (int)ETaskPriority::Count; ++priority)
+    {
+        // own deque first, newest task
+        {
+            worker_queue& own = *queues[index];
+            std::unique_lock<std::mutex> lock(own.mutex);
+            if (!own.tasks[priority].empty())
+            {
+                task = own.tasks[priority].pop_back();
+                queued_count--;
+                return true;
+            }
+        }
+        // then steal the oldest task of the same priority, skipping the deques that are busy
+        bool contended = false;
+        for (size_t offset = 1; offset < queues.size(); ++offset)
+        {
+            worker_queue& victim = *queues[(index + offset) % queues.size()];
+            std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+            if (!lock.owns_lock())
+            {
+                contended = true;
+                continue;
+            }
+            if (!victim.tasks[priority].empty())
+            {
+                task = victim.tasks[priority].pop_front();
+                queued_count--;
+                return true;
+            }
+        }
+        // nothing free elsewhere: wait for the busy ones rather than report the pool empty and come back spinning
+        for (size_t offset = 1; contended && offset < queues.size(); ++offset)
+        {
+            worker_queue& victim = *queues[(index + offset) % queues.size()];
+            std::unique_lock<std::mutex> lock(victim.mutex);
+            if (!victim.tasks[priority].empty())
+            {
+                task = victim.tasks[priority].pop_front();
+                queued_count--;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+inline bool CThreadPool::push(ETaskPriority priority, CTask&& task)
+{
+    // a task enqueueing follow-up work while the destructor drains the pool ends up here
+    if(stop)
+        return false;
+
+    const int worker = current_worker();
+    const size_t index = worker >= 0 ? (size_t)worker : next_queue++ % queues.size();
+    task_count++;
+    {
+        worker_queue& target = *queues[index];
+        std::unique_lock<std::mutex> lock(target.mutex);
+        target.tasks[(int)priority].push_back(std::move(task));
+    }
+    {
+        // taking the sleep mutex orders the count against a worker about to wait
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        queued_count++;
+    }
+    condition.notify_one();
+    return true;
+}
+
+inline bool CThreadPool::enqueue_task(CTask&& task, ETaskPriority priority)
+{
+    return push(priority, std::move(task));
+}
+
+inline void CThreadPool::wake(size_t count)
+{
+    if (count >= workers.size())
+    {
+        condition.notify_all();
+        return;
+    }
+    for (size_t i = 0; i < count; ++i)
+        condition.notify_one();
 }
 
 // add new work item to the pool
 template<class F, class... Args>
 auto CThreadPool::enqueue(F&& f, Args&&... args)
     -> std::future<typename std::result_of<F(Args...)>::type>
+{
+    return enqueue_priority(ETaskPriority::Load, std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template<class F, class... Args>
+auto CThreadPool::enqueue_priority(ETaskPriority priority, F&& f, Args&&... args)
+    -> std::future<typename std::result_of<F(Args...)>::type>
 {
     using return_type = typename std::result_of<F(Args...)>::type;
 
+    // the future needs its shared state, the wrapper itself fits inline in the task
     auto task = std::make_shared< std::packaged_task<return_type()> >(
             std::bind(std::forward<F>(f), std::forward<Args>(args)...)
         );
-        
+
     std::future<return_type> res = task->get_future();
+    push(priority, CTask([task](){ (*task)(); }));
+    return res;
+}
+
+template<class F, class... Args>
+bool CThreadPool::enqueue_detached(F&& f, Args&&... args)
+{
+    return enqueue_detached_priority(ETaskPriority::Load, std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template<class F, class... Args>
+bool CThreadPool::enqueue_detached_priority(ETaskPriority priority, F&& f, Args&&... args)
+{
+    return push(priority, CTask(std::bind(std::forward<F>(f), std::forward<Args>(args)...)));
+}
+
+template<class It>
+bool CThreadPool::enqueue_range(It first, It last, ETaskPriority priority)
+{
+    if(stop)
+        return false;
+
+    // the range goes out in fixed chunks built on the stack, one deque lock per chunk and no
+    // heap storage besides what the deques themselves may grow to
+    CTask chunk[range_chunk];
+    It it = first;
+    while (it != last)
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        size_t count = 0;
+        for (; it != last && count < range_chunk; ++it, ++count)
+            chunk[count] = CTask(std::move(*it));
 
-        // don't allow enqueueing after stopping the pool
-        if(stop)
-            throw std::runtime_error("enqueue on stopped ThreadPool");
-        task_count++;
-        tasks.emplace([task](){ (*task)(); });
+        task_count += (int)count;
+        {
+            worker_queue& target = *queues[next_queue++ % queues.size()];
+            std::unique_lock<std::mutex> lock(target.mutex);
+            for (size_t i = 0; i < count; ++i)
+                target.tasks[(int)priority].push_back(std::move(chunk[i]));
+        }
+        {
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            queued_count += (int)count;
+        }
+        wake(count);
     }
-    condition.notify_one();
-    return res;
+    return true;
 }
 
-// the destructor joins all threads
+// the destructor finishes the queued tasks and joins all threads
 inline CThreadPool::~CThreadPool()
 {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        std::unique_lock<std::mutex> lock(sleep_mutex);
         stop = true;
     }
     condition.notify_all();
@@ -121,12 +465,14 @@ inline CThreadPool::~CThreadPool()
 
 inline int CThreadPool::idleCount()
 {
-	return thread_count > task_count ? thread_count - task_count : 0;
+	const int tasks = task_count;
+	return thread_count > tasks ? thread_count - tasks : 0;
 }
 
 inline int CThreadPool::waitCount()
 {
-	return task_count > thread_count ? task_count - thread_count : 0;
+	const int tasks = task_count;
+	return tasks > thread_count ? tasks - thread_count : 0;
 }
 
 #endif
@@ -40,6 +40,8 @@ public class UdSDKUpscaling : ModuleRules
 	public UdSDKUpscaling(ReadOnlyTargetRules Target) : base(Target)
 	{
 		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+		// The awaitable CUdSDKComposite calls (Utils/CAwaitable.h) switch themselves on when the
+		// compiler implements coroutines, e.g. with CppStandard = CppStandardVersion.Latest
 		
 		PublicIncludePaths.AddRange(
 			new string[] {
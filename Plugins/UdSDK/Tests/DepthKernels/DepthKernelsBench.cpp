@@ -0,0 +1,123 @@
+// UdSDKDepthKernels.cpp timed with its VectorRegister bodies and with the scalar reference
+// (r.Uds.DepthKernels.Scalar 1) at 1080p and 4K, checking the two give the same buffers.
+// Pass --quick for the short run ctest uses.
+#include "UdSDKDepthKernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+typedef std::chrono::steady_clock FClock;
+
+static int Iterations = 20;
+
+static void SetScalar(bool bInScalar)
+{
+	*ShimConsoleVariables().at("r.Uds.DepthKernels.Scalar") = bInScalar ? 1 : 0;
+}
+
+// A UDS image: clear (1.0) background with point cloud blobs over about half the tiles
+static std::vector<float> MakeDepth(int InWidth, int InHeight)
+{
+	std::mt19937 Random(42);
+	std::uniform_real_distribution<float> Depth(0.001f, 0.999f);
+	std::vector<float> Pixels(size_t(InWidth) * InHeight, 1.0f);
+	const int Blobs = InWidth * InHeight / 20000;
+	for (int b = 0; b < Blobs; ++b)
+	{
+		const int CenterX = Random() % InWidth;
+		const int CenterY = Random() % InHeight;
+		const int Radius = 16 + Random() % 64;
+		const float BlobDepth = Depth(Random);
+		for (int y = std::max(0, CenterY - Radius); y < std::min(InHeight, CenterY + Radius); ++y)
+			for (int x = std::max(0, CenterX - Radius); x < std::min(InWidth, CenterX + Radius); ++x)
+				if ((x - CenterX) * (x - CenterX) + (y - CenterY) * (y - CenterY) < Radius * Radius)
+					Pixels[size_t(y) * InWidth + x] = BlobDepth + (x & 7) * 1e-4f;
+	}
+	return Pixels;
+}
+
+// Median ms of InKernel, InReset runs untimed before each call
+static double Time(const std::function<void()>& InReset, const std::function<void()>& InKernel)
+{
+	std::vector<double> Ms;
+	for (int i = 0; i < Iterations; ++i)
+	{
+		InReset();
+		const FClock::time_point Start = FClock::now();
+		InKernel();
+		Ms.push_back(std::chrono::duration<double, std::milli>(FClock::now() - Start).count());
+	}
+	std::sort(Ms.begin(), Ms.end());
+	return Ms[Ms.size() / 2];
+}
+
+static void Print(const char* InKernel, const char* InResolution, double InSimdMs, double InScalarMs)
+{
+	std::printf("%-24s %-6s %10.3f %10.3f %8.2fx\n", InKernel, InResolution, InSimdMs, InScalarMs, InScalarMs / InSimdMs);
+}
+
+static bool Bench(int InWidth, int InHeight, const char* InResolution)
+{
+	const std::vector<float> Source = MakeDepth(InWidth, InHeight);
+	std::vector<float> Depth = Source;
+	const std::function<void()> Reset = [&] { std::memcpy(Depth.data(), Source.data(), Source.size() * sizeof(float)); };
+	const std::function<void()> NoReset = [] {};
+	bool bSame = true;
+
+	TArray<uint8> Mask[2];
+	FIntPoint MaskSize;
+	double MaskMs[2];
+	for (int Scalar = 0; Scalar < 2; ++Scalar)
+	{
+		SetScalar(Scalar != 0);
+		MaskMs[Scalar] = Time(NoReset, [&] { UdBuildDepthTileMask(Source.data(), InWidth, InHeight, 0, Mask[Scalar], MaskSize); });
+	}
+	bSame &= Mask[0].Num() == Mask[1].Num() && std::memcmp(Mask[0].GetData(), Mask[1].GetData(), Mask[0].Num()) == 0;
+	Print("UdBuildDepthTileMask", InResolution, MaskMs[0], MaskMs[1]);
+
+	std::vector<float> DeviceZ[2];
+	double DeviceZMs[2];
+	for (int Scalar = 0; Scalar < 2; ++Scalar)
+	{
+		SetScalar(Scalar != 0);
+		DeviceZMs[Scalar] = Time(Reset, [&] { UdConvertDepthToDeviceZ(Depth.data(), InWidth, InHeight, 0); });
+		DeviceZ[Scalar] = Depth;
+	}
+	bSame &= DeviceZ[0] == DeviceZ[1];
+	Print("UdConvertDepthToDeviceZ", InResolution, DeviceZMs[0], DeviceZMs[1]);
+
+	std::vector<uint16> Half[2] = { std::vector<uint16>(Source.size()), std::vector<uint16>(Source.size()) };
+	double HalfMs[2];
+	for (int Scalar = 0; Scalar < 2; ++Scalar)
+	{
+		SetScalar(Scalar != 0);
+		HalfMs[Scalar] = Time(NoReset, [&] { UdPackDepthHalf(Source.data(), InWidth, InHeight, 0, Half[Scalar].data(), 0); });
+	}
+	bSame &= Half[0] == Half[1];
+	Print(PLATFORM_ALWAYS_HAS_AVX_2 ? "UdPackDepthHalf" : "UdPackDepthHalf (no F16C)", InResolution, HalfMs[0], HalfMs[1]);
+
+	SetScalar(false);
+	return bSame;
+}
+
+int main(int argc, char** argv)
+{
+	const bool bQuick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+	if (bQuick)
+		Iterations = 3;
+
+	std::printf("%-24s %-6s %10s %10s %9s\n", "kernel", "size", "simd ms", "scalar ms", "speedup");
+	bool bSame = Bench(1920, 1080, "1080p");
+	if (!bQuick)
+		bSame &= Bench(3840, 2160, "4K");
+	if (!bSame)
+	{
+		std::printf("the SIMD and scalar kernels disagree\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,88 @@
+#pragma once
+// The few engine types UdSDKDepthKernels.cpp touches, so the shipped kernels can be timed
+// outside the editor. Only what the kernels call is here, with the engine's semantics.
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef int32_t int32;
+
+#define FORCEINLINE inline
+#define TEXT(x) x
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define PLATFORM_ENABLE_VECTORINTRINSICS 1
+#else
+#error "the benchmark shim only has an SSE VectorRegister"
+#endif
+// UdPackDepthHalf's F16C path, on when the compiler targets it (-march=native below)
+#if defined(__AVX2__) && defined(__F16C__)
+#define PLATFORM_ALWAYS_HAS_AVX_2 1
+#else
+#define PLATFORM_ALWAYS_HAS_AVX_2 0
+#endif
+
+struct FIntPoint
+{
+	int32 X = 0;
+	int32 Y = 0;
+	FIntPoint() = default;
+	FIntPoint(int32 InX, int32 InY) : X(InX), Y(InY) {}
+};
+
+struct FMath
+{
+	template<class T> static T Min(T A, T B) { return A < B ? A : B; }
+	template<class T> static T Max(T A, T B) { return A < B ? B : A; }
+	static int32 DivideAndRoundUp(int32 A, int32 B) { return (A + B - 1) / B; }
+};
+
+template<class T>
+class TArray
+{
+public:
+	int32 Num() const { return (int32)Data.size(); }
+	T* GetData() { return Data.data(); }
+	const T* GetData() const { return Data.data(); }
+	void Reset(int32 InSlack = 0) { Data.clear(); Data.reserve(InSlack); }
+	void AddZeroed(int32 InCount) { Data.resize(Data.size() + InCount, T()); }
+	void AddDefaulted(int32 InCount) { Data.resize(Data.size() + InCount); }
+	T& operator[](int32 InIndex) { return Data[InIndex]; }
+	const T& operator[](int32 InIndex) const { return Data[InIndex]; }
+	typename std::vector<T>::iterator begin() { return Data.begin(); }
+	typename std::vector<T>::iterator end() { return Data.end(); }
+	typename std::vector<T>::const_iterator begin() const { return Data.begin(); }
+	typename std::vector<T>::const_iterator end() const { return Data.end(); }
+
+private:
+	std::vector<T> Data;
+};
+
+enum EConsoleVariableFlags { ECVF_Default = 0 };
+
+// Registered by name so the benchmark can flip r.Uds.DepthKernels.Scalar like the console would
+inline std::map<std::string, int32*>& ShimConsoleVariables()
+{
+	static std::map<std::string, int32*> Variables;
+	return Variables;
+}
+
+template<class T>
+class TAutoConsoleVariable
+{
+public:
+	TAutoConsoleVariable(const char* InName, T InDefault, const char*, EConsoleVariableFlags)
+		: Value(InDefault)
+	{
+		ShimConsoleVariables()[InName] = &Value;
+	}
+	T GetValueOnAnyThread() const { return Value; }
+
+private:
+	T Value;
+};
@@ -0,0 +1,48 @@
+#pragma once
+// FFloat16 as far as UdPackDepthHalf uses it: round to nearest even, like F16C does
+#include <cstring>
+
+class FFloat16
+{
+public:
+	uint16 Encoded = 0;
+
+	explicit FFloat16(float InValue)
+	{
+		uint32 Bits;
+		std::memcpy(&Bits, &InValue, sizeof(Bits));
+		const uint32 Sign = (Bits >> 16) & 0x8000;
+		const uint32 Abs = Bits & 0x7fffffff;
+		if (Abs >= 0x7f800000)
+		{
+			Encoded = (uint16)(Sign | 0x7c00 | (Abs > 0x7f800000 ? 0x200 : 0));
+		}
+		else if (Abs >= 0x477ff000)
+		{
+			// rounds past the largest half
+			Encoded = (uint16)(Sign | 0x7c00);
+		}
+		else if (Abs < 0x38800000)
+		{
+			// subnormal half, or zero
+			const int Shift = 126 - (int)(Abs >> 23);
+			if (Shift > 24)
+			{
+				Encoded = (uint16)Sign;
+				return;
+			}
+			const uint32 Mantissa = (Abs & 0x7fffff) | 0x800000;
+			const uint32 Half = Mantissa >> Shift;
+			const uint32 Rest = Mantissa & ((1u << Shift) - 1);
+			const uint32 Midpoint = 1u << (Shift - 1);
+			Encoded = (uint16)(Sign | (Half + (Rest > Midpoint || (Rest == Midpoint && (Half & 1)))));
+		}
+		else
+		{
+			const uint32 Rebased = Abs - 0x38000000;
+			const uint32 Rest = Rebased & 0x1fff;
+			const uint32 Half = Rebased >> 13;
+			Encoded = (uint16)(Sign | (Half + (Rest > 0x1000 || (Rest == 0x1000 && (Half & 1)))));
+		}
+	}
+};
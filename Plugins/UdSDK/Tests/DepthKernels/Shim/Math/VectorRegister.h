@@ -0,0 +1,16 @@
+#pragma once
+// The SSE VectorRegister functions the depth kernels use, as UnrealMathSSE.h defines them
+#include <emmintrin.h>
+
+typedef __m128 VectorRegister;
+
+FORCEINLINE VectorRegister VectorZero() { return _mm_setzero_ps(); }
+FORCEINLINE VectorRegister VectorOne() { return _mm_set1_ps(1.0f); }
+FORCEINLINE VectorRegister VectorLoad(const float* Ptr) { return _mm_loadu_ps(Ptr); }
+FORCEINLINE void VectorStore(VectorRegister Vec, float* Ptr) { _mm_storeu_ps(Ptr, Vec); }
+FORCEINLINE VectorRegister VectorSubtract(VectorRegister A, VectorRegister B) { return _mm_sub_ps(A, B); }
+FORCEINLINE VectorRegister VectorCompareLT(VectorRegister A, VectorRegister B) { return _mm_cmplt_ps(A, B); }
+FORCEINLINE VectorRegister VectorBitwiseOr(VectorRegister A, VectorRegister B) { return _mm_or_ps(A, B); }
+FORCEINLINE int VectorMaskBits(VectorRegister Vec) { return _mm_movemask_ps(Vec); }
+// Mask ? A : B per bit
+FORCEINLINE VectorRegister VectorSelect(VectorRegister Mask, VectorRegister A, VectorRegister B) { return _mm_xor_ps(B, _mm_and_ps(Mask, _mm_xor_ps(A, B))); }
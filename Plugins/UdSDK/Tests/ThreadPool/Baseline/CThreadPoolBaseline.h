@@ -0,0 +1,123 @@
+// The single queue pool as it was before the work-stealing rewrite, renamed so the
+// benchmarks can run it next to the current CThreadPool. Not used by the plugin.
+#ifndef THREAD_POOL_BASELINE_H
+#define THREAD_POOL_BASELINE_H
+
+#include <vector>
+#include <queue>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <stdexcept>
+#include "CSingleton.h"
+
+class CThreadPoolBaseline : public CSingleton<CThreadPoolBaseline> {
+public:
+    CThreadPoolBaseline(size_t);
+    template<class F, class... Args>
+    auto enqueue(F&& f, Args&&... args) 
+        -> std::future<typename std::result_of<F(Args...)>::type>;
+    ~CThreadPoolBaseline();
+	//idle thread count
+	int idleCount();
+	//wait task count
+	int waitCount();
+private:
+    // need to keep track of threads so we can join them
+    std::vector< std::thread > workers;
+    // the task queue
+    std::queue< std::function<void()> > tasks;
+    
+    // synchronization
+    std::mutex queue_mutex;
+    std::condition_variable condition;
+    bool stop;
+	int task_count;
+	int thread_count;
+};
+ 
+// the constructor just launches some amount of workers
+inline CThreadPoolBaseline::CThreadPoolBaseline(size_t threads)
+:stop(false),
+task_count(0)
+{
+    thread_count = (int)threads;
+    for(size_t i = 0;i<threads;++i)
+        workers.emplace_back(
+            [this]
+            {
+                for(;;)
+                {
+                    std::function<void()> task;
+
+                    {
+                        std::unique_lock<std::mutex> lock(this->queue_mutex);
+                        this->condition.wait(lock, [this]{ return this->stop || !this->tasks.empty(); });
+                        if(this->stop && this->tasks.empty())
+                            return;
+                        task = std::move(this->tasks.front());
+                        this->tasks.pop();
+                    }
+
+                    task();
+
+                    {
+                        std::unique_lock<std::mutex> lock(queue_mutex);
+                        task_count--;
+                    }
+                }
+            }
+        );
+}
+
+// add new work item to the pool
+template<class F, class... Args>
+auto CThreadPoolBaseline::enqueue(F&& f, Args&&... args)
+    -> std::future<typename std::result_of<F(Args...)>::type>
+{
+    using return_type = typename std::result_of<F(Args...)>::type;
+
+    auto task = std::make_shared< std::packaged_task<return_type()> >(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+        );
+        
+    std::future<return_type> res = task->get_future();
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+
+        // don't allow enqueueing after stopping the pool
+        if(stop)
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        task_count++;
+        tasks.emplace([task](){ (*task)(); });
+    }
+    condition.notify_one();
+    return res;
+}
+
+// the destructor joins all threads
+inline CThreadPoolBaseline::~CThreadPoolBaseline()
+{
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        stop = true;
+    }
+    condition.notify_all();
+    for(std::thread &worker: workers)
+        worker.join();
+}
+
+inline int CThreadPoolBaseline::idleCount()
+{
+	return thread_count > task_count ? thread_count - task_count : 0;
+}
+
+inline int CThreadPoolBaseline::waitCount()
+{
+	return task_count > thread_count ? task_count - thread_count : 0;
+}
+
+#endif
@@ -0,0 +1,99 @@
+// Enqueue throughput and tail latency of CThreadPool against the single queue pool it
+// replaced (Baseline/CThreadPoolBaseline.h), with 1 to 64 workers and as many producer
+// threads. Latency runs from just before the enqueue call to the start of the task.
+// Pass --quick for the short run ctest uses.
+#include "CThreadPool.h"
+#include "Baseline/CThreadPoolBaseline.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock FClock;
+
+struct FResult
+{
+	double TasksPerSecond = 0.0;
+	double P50Us = 0.0;
+	double P99Us = 0.0;
+	double P999Us = 0.0;
+};
+
+// InEnqueue(Task) submits one small callable the way the pool under test is used
+template<class FEnqueue>
+static FResult Run(int InProducers, int InTasks, FEnqueue&& InEnqueue)
+{
+	std::vector<float> Latencies(InTasks);
+	std::atomic<int> Done{ 0 };
+	const int PerProducer = InTasks / InProducers;
+	const int Total = PerProducer * InProducers;
+
+	const FClock::time_point Start = FClock::now();
+	std::vector<std::thread> Producers;
+	for (int p = 0; p < InProducers; ++p)
+	{
+		Producers.emplace_back([&, p] {
+			for (int i = 0; i < PerProducer; ++i)
+			{
+				float* Slot = &Latencies[p * PerProducer + i];
+				const FClock::time_point Enqueued = FClock::now();
+				InEnqueue([Slot, Enqueued, &Done] {
+					*Slot = std::chrono::duration<float, std::micro>(FClock::now() - Enqueued).count();
+					Done++;
+				});
+			}
+		});
+	}
+	for (std::thread& Producer : Producers)
+		Producer.join();
+	while (Done < Total)
+		std::this_thread::yield();
+	const double Seconds = std::chrono::duration<double>(FClock::now() - Start).count();
+
+	Latencies.resize(Total);
+	std::sort(Latencies.begin(), Latencies.end());
+	FResult Result;
+	Result.TasksPerSecond = Total / Seconds;
+	Result.P50Us = Latencies[Total / 2];
+	Result.P99Us = Latencies[(size_t)(Total * 0.99)];
+	Result.P999Us = Latencies[(size_t)(Total * 0.999)];
+	return Result;
+}
+
+static void Print(const char* InPool, int InThreads, const FResult& InResult)
+{
+	std::printf("%-18s %8d %14.0f %10.1f %10.1f %10.1f\n", InPool, InThreads, InResult.TasksPerSecond, InResult.P50Us, InResult.P99Us, InResult.P999Us);
+}
+
+int main(int argc, char** argv)
+{
+	const bool bQuick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+	std::vector<int> ThreadCounts = { 1, 2, 4, 8, 16, 32, 64 };
+	int Tasks = 256 * 1024;
+	if (bQuick)
+	{
+		ThreadCounts = { 1, 4 };
+		Tasks = 16 * 1024;
+	}
+
+	std::printf("hardware threads: %u, %d tasks per run\n", std::thread::hardware_concurrency(), Tasks);
+	std::printf("%-18s %8s %14s %10s %10s %10s\n", "pool", "threads", "tasks/s", "p50 us", "p99 us", "p99.9 us");
+	for (const int Threads : ThreadCounts)
+	{
+		{
+			CThreadPoolBaseline Pool(Threads);
+			Print("baseline enqueue", Threads, Run(Threads, Tasks, [&Pool](auto&& InTask) { Pool.enqueue(InTask); }));
+		}
+		{
+			CThreadPool Pool(Threads);
+			Print("enqueue", Threads, Run(Threads, Tasks, [&Pool](auto&& InTask) { Pool.enqueue(InTask); }));
+		}
+		{
+			CThreadPool Pool(Threads);
+			Print("enqueue_detached", Threads, Run(Threads, Tasks, [&Pool](auto&& InTask) { Pool.enqueue_detached(InTask); }));
+		}
+	}
+	return 0;
+}
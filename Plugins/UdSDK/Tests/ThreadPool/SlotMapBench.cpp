@@ -0,0 +1,177 @@
+// Instance table lookups: the UniqueID -> slot map with swap-remove that CUdSDKComposite uses
+// now, against the linear scan for the matching point cloud and RemoveAt it replaced.
+// Std containers stand in for TMap/TArray, the access pattern is the composite's.
+// Pass --quick for the short run ctest uses.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+typedef std::chrono::steady_clock FClock;
+
+// udRenderInstance as far as the table is concerned
+struct FInstance
+{
+	void* pPointCloud = nullptr;
+	double Matrix[16] = { 0 };
+};
+
+static void SetTransform(FInstance& InInstance, double InValue)
+{
+	for (int i = 0; i < 16; ++i)
+		InInstance.Matrix[i] = InValue + i;
+}
+
+// Before: AssetsMap gave the point cloud, the instance was found by scanning for it
+struct FLinearTable
+{
+	std::vector<FInstance> Instances;
+	std::unordered_map<uint32_t, void*> Assets;
+
+	void Add(uint32_t InUniqueID, void* InPointCloud)
+	{
+		FInstance Instance;
+		Instance.pPointCloud = InPointCloud;
+		Instances.push_back(Instance);
+		Assets[InUniqueID] = InPointCloud;
+	}
+	int Find(uint32_t InUniqueID) const
+	{
+		const auto It = Assets.find(InUniqueID);
+		if (It == Assets.end())
+			return -1;
+		for (size_t i = 0; i < Instances.size(); ++i)
+			if (Instances[i].pPointCloud == It->second)
+				return (int)i;
+		return -1;
+	}
+	bool Transform(uint32_t InUniqueID, double InValue)
+	{
+		const int Index = Find(InUniqueID);
+		if (Index < 0)
+			return false;
+		SetTransform(Instances[Index], InValue);
+		return true;
+	}
+	void Remove(uint32_t InUniqueID)
+	{
+		const int Index = Find(InUniqueID);
+		Assets.erase(InUniqueID);
+		if (Index >= 0)
+			Instances.erase(Instances.begin() + Index);
+	}
+};
+
+// After: InstanceIndices / InstanceIds, the moved instance is repointed on remove
+struct FSlotTable
+{
+	std::vector<FInstance> Instances;
+	std::vector<uint32_t> Ids;
+	std::unordered_map<uint32_t, int> Indices;
+
+	void Add(uint32_t InUniqueID, void* InPointCloud)
+	{
+		FInstance Instance;
+		Instance.pPointCloud = InPointCloud;
+		Indices[InUniqueID] = (int)Instances.size();
+		Ids.push_back(InUniqueID);
+		Instances.push_back(Instance);
+	}
+	bool Transform(uint32_t InUniqueID, double InValue)
+	{
+		const auto It = Indices.find(InUniqueID);
+		if (It == Indices.end())
+			return false;
+		SetTransform(Instances[It->second], InValue);
+		return true;
+	}
+	void Remove(uint32_t InUniqueID)
+	{
+		const auto It = Indices.find(InUniqueID);
+		if (It == Indices.end())
+			return;
+		const int Index = It->second;
+		Indices.erase(It);
+		const int LastIndex = (int)Instances.size() - 1;
+		if (Index != LastIndex)
+		{
+			Indices[Ids[LastIndex]] = Index;
+			Instances[Index] = Instances[LastIndex];
+			Ids[Index] = Ids[LastIndex];
+		}
+		Instances.pop_back();
+		Ids.pop_back();
+	}
+};
+
+struct FResult
+{
+	double TransformNs = 0.0;
+	double RemoveNs = 0.0;
+	uint64_t Checksum = 0;
+};
+
+// Fills InSlots instances, then times random transforms and random remove + reload of an actor
+template<class FTable>
+static FResult Run(int InSlots, int InTransforms, int InRemoves)
+{
+	std::mt19937 Random(1234);
+	FTable Table;
+	std::vector<uint32_t> Live;
+	for (int i = 0; i < InSlots; ++i)
+	{
+		const uint32_t UniqueID = 1000 + i;
+		Table.Add(UniqueID, (void*)(uintptr_t)(0x10000 + i * 64));
+		Live.push_back(UniqueID);
+	}
+	uint32_t NextID = 1000 + InSlots;
+
+	FResult Result;
+	std::vector<uint32_t> Picks(InTransforms);
+	for (uint32_t& Pick : Picks)
+		Pick = Live[Random() % Live.size()];
+	FClock::time_point Start = FClock::now();
+	for (int i = 0; i < InTransforms; ++i)
+		Result.Checksum += Table.Transform(Picks[i], i) ? 1 : 0;
+	Result.TransformNs = std::chrono::duration<double, std::nano>(FClock::now() - Start).count() / InTransforms;
+
+	Start = FClock::now();
+	for (int i = 0; i < InRemoves; ++i)
+	{
+		const size_t Pick = Random() % Live.size();
+		Table.Remove(Live[Pick]);
+		// the actor comes back under a new ID, the table stays at InSlots
+		Live[Pick] = NextID++;
+		Table.Add(Live[Pick], (void*)(uintptr_t)(0x10000 + Live[Pick] * 64));
+	}
+	Result.RemoveNs = std::chrono::duration<double, std::nano>(FClock::now() - Start).count() / InRemoves;
+	Result.Checksum += Table.Instances.size();
+	return Result;
+}
+
+int main(int argc, char** argv)
+{
+	const bool bQuick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+	const int Slots = bQuick ? 1000 : 10000;
+	const int Transforms = bQuick ? 10000 : 200000;
+	const int Removes = bQuick ? 1000 : 20000;
+
+	const FResult Linear = Run<FLinearTable>(Slots, Transforms, Removes);
+	const FResult Slot = Run<FSlotTable>(Slots, Transforms, Removes);
+	if (Linear.Checksum != Slot.Checksum)
+	{
+		std::printf("tables disagree: %llu vs %llu\n", (unsigned long long)Linear.Checksum, (unsigned long long)Slot.Checksum);
+		return 1;
+	}
+
+	std::printf("%d slots, %d transforms, %d remove + reload\n", Slots, Transforms, Removes);
+	std::printf("%-14s %16s %16s\n", "table", "transform ns", "remove ns");
+	std::printf("%-14s %16.1f %16.1f\n", "linear scan", Linear.TransformNs, Linear.RemoveNs);
+	std::printf("%-14s %16.1f %16.1f\n", "slot map", Slot.TransformNs, Slot.RemoveNs);
+	std::printf("speedup        %15.1fx %15.1fx\n", Linear.TransformNs / Slot.TransformNs, Linear.RemoveNs / Slot.RemoveNs);
+	return 0;
+}
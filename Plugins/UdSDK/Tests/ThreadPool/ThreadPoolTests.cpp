@@ -0,0 +1,263 @@
+// Exercises CThreadPool outside the engine: concurrent pushes, stealing between
+// workers, a pool destroyed while work is still queued, the allocations per enqueue and
+// parallel_for with every worker busy.
+#include "CThreadPool.h"
+#include "CTaskGroup.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <set>
+#include <thread>
+
+static int Failures = 0;
+
+// every heap allocation of the process while bCountAllocations is set
+static std::atomic<bool> bCountAllocations{ false };
+static std::atomic<int> AllocationCount{ 0 };
+
+void* operator new(std::size_t InSize)
+{
+	if (bCountAllocations)
+		AllocationCount++;
+	if (void* Memory = std::malloc(InSize ? InSize : 1))
+		return Memory;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* InMemory) noexcept
+{
+	std::free(InMemory);
+}
+
+void operator delete(void* InMemory, std::size_t) noexcept
+{
+	std::free(InMemory);
+}
+
+#define TEST_CHECK(Expr) \
+	do { if (!(Expr)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #Expr); Failures++; } } while (0)
+
+// outside threads and workers push at the same time, workers push onto their own deques
+static void TestConcurrentPush()
+{
+	std::atomic<int> Executed{ 0 };
+	{
+		CThreadPool Pool(4);
+		const int Producers = 4;
+		const int TasksPerProducer = 5000;
+
+		std::vector<std::thread> Threads;
+		for (int p = 0; p < Producers; ++p)
+		{
+			Threads.emplace_back([&Pool, &Executed] {
+				for (int i = 0; i < TasksPerProducer; ++i)
+				{
+					// every other task enqueues a follow-up from the worker it runs on
+					const bool bSpawn = (i & 1) != 0;
+					TEST_CHECK(Pool.enqueue_task(CTask([&Pool, &Executed, bSpawn] {
+						Executed++;
+						if (bSpawn)
+							Pool.enqueue_task(CTask([&Executed] { Executed++; }));
+					})));
+				}
+			});
+		}
+		for (std::thread& Thread : Threads)
+			Thread.join();
+
+		CTaskGroup Group;
+		Group.run([] {});
+		Group.wait_all();
+
+		const int Expected = Producers * TasksPerProducer + Producers * TasksPerProducer / 2;
+		const auto Deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (Executed < Expected && std::chrono::steady_clock::now() < Deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		TEST_CHECK(Executed == Expected);
+	}
+}
+
+// one worker fills its own deque while it stays busy, the others can only get at it by stealing
+static void TestSteal()
+{
+	std::mutex Mutex;
+	std::set<std::thread::id> Runners;
+	std::atomic<int> Executed{ 0 };
+	const int Tasks = 2000;
+	{
+		CThreadPool Pool(4);
+		std::atomic<bool> bRelease{ false };
+		Pool.enqueue_task(CTask([&] {
+			for (int i = 0; i < Tasks; ++i)
+			{
+				Pool.enqueue_task(CTask([&] {
+					{
+						std::lock_guard<std::mutex> Lock(Mutex);
+						Runners.insert(std::this_thread::get_id());
+					}
+					std::this_thread::sleep_for(std::chrono::microseconds(50));
+					Executed++;
+				}));
+			}
+			// keep the owner busy so its deque is drained by the others
+			while (!bRelease)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}));
+
+		const auto Deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (Executed < Tasks && std::chrono::steady_clock::now() < Deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		bRelease = true;
+	}
+	TEST_CHECK(Executed == Tasks);
+	TEST_CHECK(Runners.size() > 1);
+}
+
+// the destructor drains what was queued; follow-ups pushed meanwhile are either run or refused, never thrown
+static void TestStopWithPendingWork()
+{
+	const int Tasks = 1000;
+	std::atomic<int> Executed{ 0 };
+	std::atomic<int> FollowUpsAccepted{ 0 };
+	std::atomic<int> FollowUpsRefused{ 0 };
+	std::atomic<int> FollowUpsExecuted{ 0 };
+	std::atomic<int> GroupTasks{ 0 };
+	CTaskGroup Group;
+	{
+		CThreadPool Pool(2);
+		for (int i = 0; i < Tasks; ++i)
+		{
+			Pool.enqueue_task(CTask([&] {
+				std::this_thread::sleep_for(std::chrono::microseconds(20));
+				Executed++;
+				if (Pool.enqueue_task(CTask([&] { FollowUpsExecuted++; })))
+					FollowUpsAccepted++;
+				else
+					FollowUpsRefused++;
+
+				// a group fed during shutdown still empties, its task runs inline when refused
+				Group.run([&] { GroupTasks++; });
+			}));
+		}
+	}
+	Group.wait_all();
+	TEST_CHECK(Executed == Tasks);
+	TEST_CHECK(FollowUpsAccepted + FollowUpsRefused == Tasks);
+	TEST_CHECK(FollowUpsExecuted == FollowUpsAccepted);
+	TEST_CHECK(GroupTasks == Tasks);
+	std::printf("stop: %d follow-ups ran, %d refused\n", FollowUpsExecuted.load(), FollowUpsRefused.load());
+}
+
+// once the deques have grown, small tasks cost no allocation through enqueue_task or enqueue_range
+static void TestNoAllocations()
+{
+	const int Workers = 4;
+	CThreadPool Pool(Workers);
+	std::atomic<int> Executed{ 0 };
+	std::atomic<int> Blocked{ 0 };
+	std::atomic<bool> bRelease{ false };
+	std::vector<CTask> Range;
+	Range.reserve(1024);
+
+	// keeps every worker busy so what is enqueued afterwards stays in the deques
+	auto Block = [&] {
+		bRelease = false;
+		for (int i = 0; i < Workers; ++i)
+		{
+			Pool.enqueue_task(CTask([&] {
+				Blocked++;
+				while (!bRelease)
+					std::this_thread::yield();
+				Blocked--;
+			}));
+		}
+		while (Blocked < Workers)
+			std::this_thread::yield();
+	};
+	auto Drain = [&](int InExpected) {
+		bRelease = true;
+		// the next Block() must not catch a gate that has not seen the release yet
+		while (Executed < InExpected || Blocked > 0)
+			std::this_thread::yield();
+	};
+	auto Submit = [&](int InCount) {
+		for (int i = 0; i < InCount; ++i)
+			Pool.enqueue_task(CTask([&Executed] { Executed++; }));
+		for (int i = 0; i < InCount; ++i)
+			Range.emplace_back([&Executed] { Executed++; });
+		Pool.enqueue_range(Range.begin(), Range.end());
+		Range.clear();
+	};
+
+	// grow the deques past anything the measured round needs
+	Block();
+	Submit(1024);
+	Drain(2048);
+
+	Block();
+	bCountAllocations = true;
+	Submit(256);
+	bCountAllocations = false;
+	Drain(2048 + 512);
+
+	TEST_CHECK(AllocationCount == 0);
+	if (AllocationCount != 0)
+		std::printf("allocations: %d\n", AllocationCount.load());
+}
+
+// every worker blocked (as in a udPointCloud_Load) must not hold up a parallel_for, the caller runs it all
+static void TestParallelForWithBusyWorkers()
+{
+	const int Workers = 3;
+	const int Count = 32;
+	CThreadPool Pool(Workers);
+	std::atomic<int> Blocked{ 0 };
+	std::atomic<bool> bRelease{ false };
+	for (int i = 0; i < Workers; ++i)
+	{
+		Pool.enqueue_task(CTask([&] {
+			Blocked++;
+			while (!bRelease)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}));
+	}
+	while (Blocked < Workers)
+		std::this_thread::yield();
+
+	std::vector<int> Hits(Count, 0);
+	const std::thread::id Caller = std::this_thread::get_id();
+	bool bAllOnCaller = true;
+	parallel_for(Count, [&](int InIndex) {
+		Hits[InIndex]++;
+		if (std::this_thread::get_id() != Caller)
+			bAllOnCaller = false;
+	});
+	bRelease = true;
+
+	for (int i = 0; i < Count; ++i)
+		TEST_CHECK(Hits[i] == 1);
+	TEST_CHECK(bAllOnCaller);
+
+	// with the workers free again they share the loop, every index still runs once
+	std::vector<std::atomic<int>> Shared(Count);
+	parallel_for(Count, [&](int InIndex) {
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+		Shared[InIndex]++;
+	});
+	for (int i = 0; i < Count; ++i)
+		TEST_CHECK(Shared[i] == 1);
+}
+
+int main()
+{
+	TestConcurrentPush();
+	TestSteal();
+	TestStopWithPendingWork();
+	TestNoAllocations();
+	TestParallelForWithBusyWorkers();
+
+	if (Failures == 0)
+		std::printf("all thread pool tests passed\n");
+	return Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+// Scaling of the banded UDS render (CUdSDKComposite::RenderTiles) with the thread count, at
+// 1080p, 1440p and 4K. udSDK is not available outside the engine, so each band runs a fixed
+// per-pixel kernel of comparable arithmetic instead of udRenderContext_Render; what is measured
+// is how parallel_for spreads the bands, including with every worker stuck in a load.
+// Pass --quick for the short run ctest uses.
+#include "CThreadPool.h"
+#include "CTaskGroup.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+struct FResolution
+{
+	const char* Name;
+	int Width;
+	int Height;
+};
+
+// stands in for a band render: a few dozen flops per pixel written to color and depth
+static void RenderBand(int InWidth, int InY, int InHeight, uint32_t* OutColor, float* OutDepth)
+{
+	for (int y = InY; y < InY + InHeight; ++y)
+	{
+		for (int x = 0; x < InWidth; ++x)
+		{
+			float u = x * 0.001f, v = y * 0.001f, d = 0.0f;
+			for (int i = 0; i < 8; ++i)
+			{
+				d += std::sqrt(u * u + v * v + 1.0f);
+				u = u * 0.75f + v * 0.25f;
+				v = v * 0.75f - u * 0.25f;
+			}
+			OutDepth[y * InWidth + x] = d;
+			OutColor[y * InWidth + x] = 0xFF000000u | (uint32_t)(d * 1000.0f);
+		}
+	}
+}
+
+static double MedianMs(std::vector<double>& InSamples)
+{
+	std::sort(InSamples.begin(), InSamples.end());
+	return InSamples[InSamples.size() / 2];
+}
+
+static double RenderFrames(const FResolution& InResolution, int InTiles, int InFrames, std::vector<uint32_t>& Color, std::vector<float>& Depth)
+{
+	std::vector<double> Samples;
+	for (int Frame = 0; Frame < InFrames; ++Frame)
+	{
+		const auto Start = std::chrono::steady_clock::now();
+		// same split as RecreateTiles: equal bands, the last one takes the remainder
+		const int BandHeight = InResolution.Height / InTiles;
+		parallel_for(InTiles, [&](int InTile) {
+			const int Y = InTile * BandHeight;
+			const int Height = InTile == InTiles - 1 ? InResolution.Height - Y : BandHeight;
+			RenderBand(InResolution.Width, Y, Height, Color.data(), Depth.data());
+		});
+		Samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count());
+	}
+	return MedianMs(Samples);
+}
+
+int main(int argc, char** argv)
+{
+	const bool bQuick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+	std::vector<FResolution> Resolutions = { { "1080p", 1920, 1080 }, { "1440p", 2560, 1440 }, { "4K", 3840, 2160 } };
+	std::vector<int> ThreadCounts = { 1, 2, 4, 8, 16, 32 };
+	int Frames = 9;
+	if (bQuick)
+	{
+		Resolutions.resize(1);
+		ThreadCounts = { 1, 2, 4 };
+		Frames = 3;
+	}
+
+	std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+	std::printf("%-6s %8s %12s %9s %20s\n", "res", "threads", "frame ms", "speedup", "workers busy ms");
+	for (const FResolution& Resolution : Resolutions)
+	{
+		std::vector<uint32_t> Color(Resolution.Width * Resolution.Height);
+		std::vector<float> Depth(Resolution.Width * Resolution.Height);
+		double BaseMs = 0.0;
+		for (const int Threads : ThreadCounts)
+		{
+			// one band per thread, the render thread renders alongside Threads - 1 workers
+			double FrameMs = 0.0;
+			double BusyMs = 0.0;
+			{
+				CThreadPool Pool((size_t)std::max(1, Threads - 1));
+				FrameMs = RenderFrames(Resolution, Threads, Frames, Color, Depth);
+
+				// the same frame while every worker sits in a blocking call: the caller does all of it
+				std::atomic<int> Blocked{ 0 };
+				std::atomic<bool> bRelease{ false };
+				const int Workers = std::max(1, Threads - 1);
+				for (int i = 0; i < Workers; ++i)
+				{
+					Pool.enqueue_task(CTask([&] {
+						Blocked++;
+						while (!bRelease)
+							std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					}));
+				}
+				while (Blocked < Workers)
+					std::this_thread::yield();
+				BusyMs = RenderFrames(Resolution, Threads, 1, Color, Depth);
+				bRelease = true;
+			}
+			if (Threads == 1)
+				BaseMs = FrameMs;
+			std::printf("%-6s %8d %12.2f %8.2fx %20.2f\n", Resolution.Name, Threads, FrameMs, BaseMs / FrameMs, BusyMs);
+		}
+	}
+	return 0;
+}